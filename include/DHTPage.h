@@ -4,6 +4,7 @@
 #include <Adafruit_GFX.h>
 #include <Adafruit_ST7789.h>
 #include <DHT.h>
+#include "GasAlarm.h"
 
 // DHT22 configuration
 #define DHT_PIN    32
@@ -14,29 +15,29 @@
 
 class DHTPage {
 public:
-    DHTPage(Adafruit_ST7789 &display);
+    DHTPage(Adafruit_ST7789 &display, GasAlarm &gasAlarm);
     void setup();
     void update(bool forceRender);
 
     // Getters to retrieve the sensor data
     float getTemperature();  // Getter for temperature
     float getHumidity();     // Getter for humidity
-    String getGasQuality();  // Getter for gas quality
+    GasQuality getGasQuality();  // Getter for gas quality
     float getMQ5Percentage();
 
 private:
     Adafruit_ST7789 &tft; // Reference to the display
+    GasAlarm &gasAlarm;   // Samples the MQ-5 in the background
     DHT dht;
 
     // Variables to store previous readings
     int lastTemperature = -999;
     int lastHumidity = -999;
-    String lastGasQuality = "Unknown";
+    GasQuality lastGasQuality = GasQuality::Unknown;
 
     float readMQ5();
-    String determineGasQuality(float mq5Percentage);
-    void updateDisplay(int temperature, int humidity, const String& gasQuality, bool forceRender);
-    void updateDisplay(const String& message);
+    void updateDisplay(int temperature, int humidity, GasQuality gasQuality, bool forceRender);
+    void updateDisplay(const char* message);
 
     // Declaration of the functions to draw the icons
     void drawCelsiusIcon();  
@@ -0,0 +1,73 @@
+#ifndef DELTA_UPDATE_H
+#define DELTA_UPDATE_H
+
+#include <Arduino.h>
+#include <rom/miniz.h>
+#include <esp_partition.h>
+#include <mbedtls/sha256.h>
+
+#define DELTA_MAGIC         "WSD1"
+#define DELTA_HEADER_SIZE   76    // Magic, source size and SHA-256, target size and SHA-256
+#define DELTA_COMMAND_SIZE  12    // Source offset, diff length, extra length
+#define DELTA_SOURCE_CHUNK  1024  // Bytes read from the running partition at a time
+
+// Applies a patch made by tools/make_delta.py while it is being received. The source bytes come
+// from the running partition, the reconstructed image streams through Update into the inactive
+// OTA slot, and it is only made bootable if its size and SHA-256 match the patch header.
+// Needs about 44 KB of heap (inflate state and window) between begin() and end()/abort().
+class DeltaUpdate {
+public:
+    DeltaUpdate();
+    ~DeltaUpdate();
+
+    bool begin();
+    bool write(const uint8_t *data, size_t len);  // Any chunk size
+    bool end();    // Verifies and commits the image
+    void abort();  // Safe to call at any time
+
+    const char *errorString() const;
+    size_t targetSize() const;  // 0 until the header was received
+    size_t written() const;     // Image bytes produced so far
+
+private:
+    enum class Stage : uint8_t {
+        Header,
+        Command,
+        Diff,
+        Extra,
+        Done,
+        Failed
+    };
+
+    Stage stage;
+    const char *error;
+    const esp_partition_t *source;
+    tinfl_decompressor *inflator;
+    uint8_t *window;  // TINFL_LZ_DICT_SIZE, the inflate output wraps around it
+    size_t windowPosition;
+    bool streamEnded;
+
+    uint8_t header[DELTA_HEADER_SIZE];
+    uint8_t command[DELTA_COMMAND_SIZE];
+    size_t collected;  // Bytes of header or command received so far
+    uint32_t sourceSize;
+    uint32_t targetLength;
+    uint32_t produced;
+    uint32_t sourceOffset;
+    uint32_t diffLeft;
+    uint32_t extraLeft;
+
+    uint8_t sourceBuffer[DELTA_SOURCE_CHUNK];
+    mbedtls_sha256_context targetHash;
+
+    bool fail(const char *reason);
+    bool parseHeader();
+    bool verifySource();
+    bool parseCommand();
+    bool inflate(const uint8_t *data, size_t len);
+    bool consume(const uint8_t *data, size_t len);
+    bool output(const uint8_t *data, size_t len);
+    void release();
+};
+
+#endif // DELTA_UPDATE_H
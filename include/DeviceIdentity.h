@@ -0,0 +1,28 @@
+#ifndef DEVICE_IDENTITY_H
+#define DEVICE_IDENTITY_H
+
+#include <Arduino.h>
+
+// Optional station name, e.g. build_flags = -DDEVICE_NAME=\"kitchen\"
+// When empty, the last three bytes of the MAC address are used instead.
+#ifndef DEVICE_NAME
+#define DEVICE_NAME ""
+#endif
+
+// Root of the MQTT topic tree, topics become <root>/<device id>/<metric>
+#ifndef MQTT_TOPIC_ROOT
+#define MQTT_TOPIC_ROOT "home"
+#endif
+
+#define DEVICE_ID_MAX_LENGTH     24
+#define DEVICE_STRING_LENGTH     48
+
+// Build the identity strings once at startup (before WiFi, OTA and MQTT are set up)
+void setupDeviceIdentity();
+
+const char* getDeviceId();      // Configured name or MAC suffix, e.g. "kitchen" or "a1b2c3"
+const char* getHostname();      // e.g. "weatherstation-kitchen"
+const char* getMqttClientId();  // Always unique per board, e.g. "weatherstation-a1b2c3"
+const char* getTopicPrefix();   // e.g. "home/kitchen"
+
+#endif // DEVICE_IDENTITY_H
@@ -0,0 +1,61 @@
+#ifndef FORECAST_PAGE_H
+#define FORECAST_PAGE_H
+
+#include <Adafruit_GFX.h>
+#include <Adafruit_ST7789.h>
+#include <ArduinoJson.h>
+#include "WeatherPage.h"
+#include "WeatherHttpSession.h"
+
+#define FORECAST_DAYS 5
+#define FORECAST_CACHE_VERSION 1
+
+// One day of the 5-day/3-hour forecast, reduced while streaming the response
+struct ForecastDay {
+    int32_t day;             // Local days since epoch
+    int16_t minTemp;         // Tenths of a degree Celsius
+    int16_t maxTemp;         // Tenths of a degree Celsius
+    uint16_t conditionId;    // Dominant OpenWeatherMap condition ID
+    uint16_t precipitation;  // Rain and snow, tenths of a millimetre
+};
+
+// Cached forecast, kept in RAM and mirrored to NVS
+struct Forecast {
+    uint32_t version;
+    uint32_t fetchedAt;      // Epoch seconds, 0 if the clock was not set
+    uint8_t dayCount;
+    ForecastDay days[FORECAST_DAYS];
+};
+
+class ForecastPage {
+public:
+    ForecastPage(Adafruit_ST7789 &display, WeatherHttpSession &session, const WeatherPage &weather, const char *apiKey, const char *city);
+    void setup();
+    void update(bool forceRender);
+
+    bool refresh();                         // Fetch now, returns false on failure
+    unsigned long dataAge() const;          // Milliseconds since the data was fetched, ULONG_MAX if none
+    unsigned long refreshInterval() const;  // Age after which the data counts as stale
+
+private:
+    Adafruit_ST7789 &tft;
+    WeatherHttpSession &session;
+    const WeatherPage &weather;  // Provides the city's UTC offset for day boundaries
+    const char *apiKey;
+    const char *city;
+    char path[WEATHER_PATH_LENGTH];  // Request path, formatted once in setup()
+    HttpCacheEntry cache;
+    Forecast forecast;
+    JsonDocument filter;  // Fields kept from each forecast entry, built once in setup()
+
+    unsigned long lastUpdateTime;
+    bool changed;  // Refreshed forecast not drawn yet
+    const unsigned long updateInterval = 10800000;  // 3 hours in milliseconds
+
+    bool getForecast();
+    void loadCache();
+    void saveCache();
+    void displayForecast();
+};
+
+#endif // FORECAST_PAGE_H
@@ -0,0 +1,55 @@
+#ifndef GAS_ALARM_H
+#define GAS_ALARM_H
+
+#include <Arduino.h>
+#include <Adafruit_ST7789.h>
+
+// Gas level (percent) at which the alarm is raised, and the level it has to drop below to clear
+#define GAS_ALARM_THRESHOLD         65.0
+#define GAS_ALARM_CLEAR_THRESHOLD   60.0
+
+#define GAS_ALARM_SAMPLE_INTERVAL   100   // ms between MQ-5 samples
+#define GAS_ALARM_TASK_PRIORITY     3     // Above the Arduino loop task (1)
+#define GAS_ALARM_TASK_STACK        4096
+
+// Air quality class shown on the DHT page and published on mq5/gas
+enum class GasQuality : uint8_t {
+    Unknown,  // No reading classified yet
+    Excellent,
+    Good,
+    OK,
+    Bad,
+    Danger
+};
+
+GasQuality classifyGasQuality(float mq5Percentage);
+const char *gasQualityName(GasQuality quality);  // Constant string, e.g. "Good"
+
+// Samples the MQ-5 in its own high-priority task and raises the alarm as soon as a sample crosses
+// the threshold. The MQTT alarm is published straight from that task, so it does not wait behind
+// a blocking weather fetch or the publish deadband. The screen overlay is drawn by the loop task,
+// which owns the display.
+class GasAlarm {
+public:
+    GasAlarm(int pin);
+    void begin();                  // Start the sampling task (after setupMQTT)
+    float getPercentage() const;   // Latest sample, 0-100 %
+    bool isActive() const;
+
+    // Draw or clear the alert overlay. Returns true while the overlay owns the screen.
+    // forceRender redraws it completely, e.g. after something else cleared the screen.
+    bool updateOverlay(Adafruit_ST7789 &tft, bool forceRender);
+
+private:
+    int pin;
+    volatile float percentage;
+    volatile bool active;
+    volatile bool overlayDirty;    // Alarm state changed since the overlay was last drawn
+    bool overlayShown;
+    int lastShownLevel;
+
+    static void taskEntry(void *param);
+    void sample();
+};
+
+#endif // GAS_ALARM_H
@@ -0,0 +1,17 @@
+#ifndef HA_DISCOVERY_H
+#define HA_DISCOVERY_H
+
+#include "MQTTSession.h"
+
+// Home Assistant discovery prefix and the topic its birth message is published on
+#ifndef HA_DISCOVERY_PREFIX
+#define HA_DISCOVERY_PREFIX "homeassistant"
+#endif
+#define HA_STATUS_TOPIC HA_DISCOVERY_PREFIX "/status"
+#define HA_DISCOVERY_PAYLOAD_SIZE 512
+
+// Publish a retained discovery config for every metric. Call on (re)connect and
+// whenever Home Assistant announces itself on HA_STATUS_TOPIC, not on every cycle.
+void publishHomeAssistantDiscovery(MQTTSession &client);
+
+#endif // HA_DISCOVERY_H
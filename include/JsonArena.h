@@ -0,0 +1,30 @@
+#ifndef JSON_ARENA_H
+#define JSON_ARENA_H
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include "MemArena.h"
+
+// ArduinoJson allocator that takes its blocks from a MemArena instead of the heap.
+// Everything the document allocated is given back when the JsonArena goes out of scope,
+// so declare it before the JsonDocument using it.
+class JsonArena : public ArduinoJson::Allocator {
+public:
+    explicit JsonArena(MemArena &arena);
+    ~JsonArena();
+
+    void *allocate(size_t size) override;
+    void deallocate(void *ptr) override;
+    void *reallocate(void *ptr, size_t newSize) override;
+
+    void reset();               // Drop the document's blocks; only call once the document is gone
+    size_t used() const;
+    size_t peak() const;        // Most used at once since construction
+
+private:
+    MemArena &arena;
+    size_t start;               // Arena mark when the scope began
+    size_t highWater;
+};
+
+#endif // JSON_ARENA_H
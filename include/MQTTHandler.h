@@ -1,9 +1,14 @@
 #ifndef MQTT_HANDLER_H
 #define MQTT_HANDLER_H
 
-#include <PubSubClient.h>
+#include <Arduino.h>
 #include <vector>
 #include <string>
+#include "GasAlarm.h"
+#include "MemArena.h"
+
+// Scratch memory for building and parsing messages: weather share JSON, discovery payloads
+#define MQTT_ARENA_SIZE 640
 
 // Data structure to hold sensor topic and its value
 struct SensorData {
@@ -11,16 +16,61 @@ struct SensorData {
     String value;       // Sensor value to publish
 };
 
+// Metrics published by the station, used to index topic tables and queued samples
+enum class Metric : uint8_t {
+    Temperature,
+    Humidity,
+    MQ5Percentage,
+    GasQuality,
+    WiFiSignal,
+    IpAddress,
+    MacAddress,
+    CpuFreq,
+    FreeMem,
+    HeapMaxAlloc,     // Largest free block
+    HeapMinFree,      // Lowest free heap since boot
+    HeapAllocations,  // JSON, allocation counters per subsystem
+    Count  // Number of metrics, keep last
+};
+
 // Function to set up the MQTT connection
 void setupMQTT(const char* user, const char* password);
 
 // Function to maintain MQTT connection with user credentials
 void maintainMQTTConnection(const char* user, const char* password);
 
+// Publish a gas alarm state change on <prefix>/mq5/alarm right away. Safe to call from any task;
+// if the session is busy or down the state is sent right after the next reconnect.
+bool publishGasAlarm(bool danger, float level, uint32_t detectedAt);
+
+// Publish a retained weather snapshot for the other stations (see WeatherShare.h)
+bool publishSharedWeather(const char* topic, const char* payload);
+
+// Counters since boot, for the monitoring endpoints
+struct MQTTStats {
+    bool connected;
+    uint32_t connects;      // Successful connects, including the first one
+    uint32_t published;     // Sensor values handed to the session
+    uint32_t downgraded;    // Of those, sent at QoS 0 because the window was full or the message too large
+    uint32_t acknowledged;  // QoS 1 messages acknowledged by the broker
+    uint32_t retransmits;
+    uint32_t queued;        // Samples waiting in the offline queue
+    uint32_t dropped;       // Samples the offline queue had to discard
+};
+
+MQTTStats getMQTTStats();
+
+// Preformatted topics, valid after setupMQTT
+const char* getMetricTopic(Metric metric);
+const char* getAvailabilityTopic();  // "online"/"offline", retained
+
+// Reserved at boot for the loop task. Rewind to a mark() once a message is handled.
+MemArena &getMqttArena();
+
 
 // Function to process sensor data, compare with last values, and publish if changes are detected
-void processAndPublishSensorData(float dhtTemp, float dhtHumidity, float mq5Percentage, const String& gasQuality, 
-                                int wifiSignalStrength, const String& ipAddress, const String& macAddress, 
-                                int cpuFreq, const String& freeMem);
+void processAndPublishSensorData(float dhtTemp, float dhtHumidity, float mq5Percentage, GasQuality gasQuality, 
+                                int wifiSignalStrength, const char* ipAddress, const char* macAddress, 
+                                int cpuFreq, uint32_t freeHeap);
 
 #endif
@@ -0,0 +1,120 @@
+#ifndef MQTT_SESSION_H
+#define MQTT_SESSION_H
+
+#include <Arduino.h>
+#include <Client.h>
+
+// Maximum number of unacknowledged QoS 1 messages (can be overridden via build_flags)
+#ifndef MQTT_INFLIGHT_WINDOW
+#define MQTT_INFLIGHT_WINDOW        8
+#endif
+
+// Time before an unacknowledged QoS 1 message is sent again with the DUP flag
+#ifndef MQTT_RETRANSMIT_TIMEOUT
+#define MQTT_RETRANSMIT_TIMEOUT     5000
+#endif
+
+#define MQTT_KEEPALIVE_SECONDS      15
+#define MQTT_CONNECT_TIMEOUT        3000
+#define MQTT_MAX_TOPIC_LENGTH       96
+#define MQTT_MAX_INFLIGHT_PAYLOAD   192  // Largest QoS 1 payload, the esp32/allocations JSON needs about 150
+#define MQTT_RX_BUFFER_SIZE         512
+
+// Connection states, matching PubSubClient's values so logs stay comparable
+#define MQTT_STATE_CONNECTION_TIMEOUT   -4
+#define MQTT_STATE_CONNECTION_LOST      -3
+#define MQTT_STATE_CONNECT_FAILED       -2
+#define MQTT_STATE_DISCONNECTED         -1
+#define MQTT_STATE_CONNECTED            0
+
+typedef void (*MQTTMessageCallback)(const char *topic, const uint8_t *payload, size_t length);
+
+// Minimal MQTT 3.1.1 client with QoS 1 publishing.
+// Up to MQTT_INFLIGHT_WINDOW messages may be awaiting their PUBACK at the same time, so
+// acknowledged delivery does not wait for a round trip per message. Unacknowledged messages
+// survive reconnects and are resent into the persistent session.
+class MQTTSession {
+public:
+    MQTTSession(Client &client);
+    void setServer(const char *host, uint16_t port);
+    void setCallback(MQTTMessageCallback callback);
+    void setWill(const char *topic, const char *payload, bool retain);  // Sent by the broker if we drop off
+
+    // Opens the connection and sends CONNECT without waiting for the broker's answer.
+    // Returns true once connected; while connecting() call it again to check for the CONNACK.
+    bool connect(const char *clientId, const char *user, const char *password, bool cleanSession);
+    void disconnect();
+    bool connected();
+    bool connecting() const;  // CONNECT sent, waiting for the CONNACK
+    int state() const;
+    bool sessionPresent() const;
+
+    // Returns false if the message could not be handed to the broker (disconnected, window full,
+    // or too large for an in-flight slot at QoS 1)
+    bool publish(const char *topic, const char *payload, bool retain, uint8_t qos = 0);
+    bool subscribe(const char *topic);
+    bool canPublish() const;  // True if a QoS 1 publish would currently be accepted
+    void loop();
+
+    uint8_t inflightCount() const;
+    uint32_t acknowledgedCount() const;
+    uint32_t retransmitCount() const;
+    uint32_t oversizedCount() const;  // QoS 1 publishes refused for a topic or payload too large
+
+private:
+    struct InflightMessage {
+        bool used;
+        bool retain;
+        uint16_t packetId;
+        uint8_t attempts;
+        unsigned long sentAt;
+        uint16_t payloadLength;
+        char topic[MQTT_MAX_TOPIC_LENGTH];
+        char payload[MQTT_MAX_INFLIGHT_PAYLOAD];
+    };
+
+    Client &client;
+    const char *host;
+    uint16_t port;
+    MQTTMessageCallback callback;
+    const char *willTopic;
+    const char *willPayload;
+    bool willRetain;
+
+    int currentState;
+    bool sessionWasPresent;
+    uint16_t nextPacketId;
+    unsigned long lastOutbound;
+    unsigned long lastInbound;
+    bool pingOutstanding;
+    bool awaitingConnack;
+    unsigned long connectStartedAt;
+
+    InflightMessage inflight[MQTT_INFLIGHT_WINDOW];
+    uint8_t inflightUsed;
+    uint32_t acknowledged;
+    uint32_t retransmits;
+    uint32_t oversized;
+
+    // Incoming packet parser state
+    uint8_t rxType;
+    uint32_t rxLength;
+    uint32_t rxReceived;
+    uint8_t rxLengthShift;
+    uint8_t rxStage;
+    uint8_t rxBuffer[MQTT_RX_BUFFER_SIZE];
+
+    bool finishConnect();
+    uint16_t allocatePacketId();
+    bool sendPublish(const char *topic, const uint8_t *payload, size_t length, bool retain,
+                     uint8_t qos, bool dup, uint16_t packetId);
+    bool sendPacket(uint8_t header, const uint8_t *variable, size_t variableLength,
+                    const uint8_t *payload, size_t payloadLength);
+    bool sendSimple(uint8_t header, uint16_t packetId);
+    void retransmitExpired(bool all);
+    void readPackets();
+    void handlePacket();
+    void markDisconnected(int reason);
+};
+
+#endif // MQTT_SESSION_H
@@ -0,0 +1,46 @@
+#ifndef MEM_ARENA_H
+#define MEM_ARENA_H
+
+#include <Arduino.h>
+
+// Fixed buffer handed out front to back, reserved at boot so a subsystem's working memory
+// never comes from (or fragments) the heap. Blocks are only reclaimed together: reset() after
+// each transaction, or rewind() to a mark() for nested scopes. The most recent block can also
+// grow, shrink or be released in place. Not locked, each arena belongs to one task.
+// Declare buffers alignas(max_align_t); an unaligned buffer loses its first few bytes.
+class MemArena {
+public:
+    MemArena(const char *name, uint8_t *buffer, size_t capacity);
+
+    void *allocate(size_t size);  // nullptr when full
+    void *reallocate(void *ptr, size_t newSize);
+    void deallocate(void *ptr);
+
+    size_t mark() const;          // Current fill level, for rewind()
+    void rewind(size_t mark);     // Drop every block allocated since mark()
+    void reset();                 // Drop everything
+
+    const char *name() const;
+    size_t used() const;
+    size_t peak() const;          // High-water mark since boot
+    size_t capacity() const;
+    uint32_t failures() const;    // Allocations refused because the arena was full
+
+    // All arenas, for telemetry
+    static MemArena *first();
+    MemArena *next() const;
+
+private:
+    const char *label;
+    uint8_t *buffer;
+    size_t size;
+    size_t offset;
+    size_t lastBlock;             // Offset of the most recent block's header
+    size_t highWater;
+    uint32_t refused;
+    MemArena *nextArena;
+
+    static MemArena *arenas;
+};
+
+#endif // MEM_ARENA_H
@@ -0,0 +1,77 @@
+#ifndef MEM_STATS_H
+#define MEM_STATS_H
+
+#include <Arduino.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+// Record every allocation's call site in a ring buffer, e.g. build_flags = -DMEM_TRACE=1.
+// Read it on /api/memory/trace and resolve the addresses with xtensa-esp32-elf-addr2line.
+#ifndef MEM_TRACE
+#define MEM_TRACE 0
+#endif
+
+#define MEM_TRACE_SIZE  64  // Allocations kept in the trace ring
+#define MEM_TASK_SLOTS  4   // Tasks that can be assigned to a subsystem as a whole
+
+// Counts heap allocations. malloc, calloc and realloc (and with them new and String) are routed
+// through MemStats.cpp by the -Wl,--wrap flags in platformio.ini; without them the counts stay 0.
+// Allocations made by the task that called beginMemStats() are also counted on their own, so
+// loop() passes can be checked for heap churn independently of the network tasks.
+void beginMemStats();  // Call from the loop task
+
+uint32_t allocationCount();      // All tasks since boot
+uint32_t loopAllocationCount();  // Loop task since beginMemStats()
+
+// Who allocations are charged to. The loop task charges the subsystem of the innermost MemScope,
+// other tasks the subsystem they were assigned with assignMemTask(), Other if none.
+enum class MemSubsystem : uint8_t {
+    Other,
+    Weather,
+    MQTT,
+    Web,
+    Display,
+    Count  // Number of subsystems, keep last
+};
+
+const char *memSubsystemName(MemSubsystem subsystem);  // e.g. "weather"
+void assignMemTask(TaskHandle_t task, MemSubsystem subsystem);
+
+// Charges the loop task's allocations to a subsystem while in scope. Does nothing on other tasks.
+class MemScope {
+public:
+    explicit MemScope(MemSubsystem subsystem);
+    ~MemScope();
+
+private:
+    MemSubsystem previous;
+    bool active;
+};
+
+// Heap state and the counters since boot
+struct MemSnapshot {
+    uint32_t freeHeap;
+    uint32_t largestBlock;   // Largest block that can be allocated
+    uint32_t minFreeHeap;    // Lowest free heap since boot
+    uint8_t fragmentation;   // Percent of the free heap outside the largest block
+    uint32_t allocations[static_cast<size_t>(MemSubsystem::Count)];
+    uint32_t bytes[static_cast<size_t>(MemSubsystem::Count)];  // Requested since boot, frees not subtracted
+};
+
+void readMemSnapshot(MemSnapshot &snapshot);
+
+// One allocation recorded with MEM_TRACE
+struct MemTraceEntry {
+    uint32_t time;    // millis()
+    uint32_t caller;  // Return address into the code that called malloc
+    uint32_t size;
+    MemSubsystem subsystem;
+};
+
+// Copy the trace ring out, oldest first. Returns the number of entries, 0 without MEM_TRACE.
+size_t readMemTrace(MemTraceEntry *entries, size_t maxEntries);
+
+// Byte count for display, e.g. "182 KB"
+void formatMemory(size_t bytes, char *buffer, size_t size);
+
+#endif // MEM_STATS_H
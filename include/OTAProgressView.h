@@ -0,0 +1,25 @@
+#ifndef OTA_PROGRESS_VIEW_H
+#define OTA_PROGRESS_VIEW_H
+
+#include <Adafruit_GFX.h>
+#include <Adafruit_ST7789.h>
+
+// Firmware update progress, shared by ArduinoOTA and the web /update path. The frame is drawn
+// once in begin(); update() only fills the new part of the bar and overwrites the percentage
+// and byte count in place, and only when the integer percentage changed.
+class OTAProgressView {
+public:
+    OTAProgressView(Adafruit_ST7789 &tft);
+
+    void begin(const char *title);
+    bool update(size_t done, size_t total);  // total 0 if unknown. Returns true if anything was drawn.
+    void showResult(bool success, const char *detail);
+
+private:
+    Adafruit_ST7789 &tft;
+    int drawnPercent;       // -1 if nothing drawn yet
+    int16_t drawnWidth;     // Filled part of the bar, in pixels
+    uint32_t drawnKilobytes;
+};
+
+#endif // OTA_PROGRESS_VIEW_H
@@ -1,7 +1,9 @@
 #ifndef OTA_UPDATE_H
 #define OTA_UPDATE_H
 
-void setupOTA(const char* otaPassword);
+#include "OTAProgressView.h"
+
+void setupOTA(const char* otaPassword, OTAProgressView &progressView);
 void handleOTA();
 
 #endif
@@ -0,0 +1,70 @@
+#ifndef OFFLINE_QUEUE_H
+#define OFFLINE_QUEUE_H
+
+#include <Arduino.h>
+
+// Capacity of the in-RAM ring buffer (number of samples)
+#define OFFLINE_QUEUE_CAPACITY      64
+// Number of oldest samples moved to flash when the RAM ring is full
+#define OFFLINE_QUEUE_SPILL_BATCH   32
+// Upper bound for the flash spill file (number of samples)
+#define OFFLINE_QUEUE_SPILL_MAX     2048
+// Number of samples read back from flash in one go
+#define OFFLINE_QUEUE_READ_BATCH    8
+
+// Sample flags
+#define SAMPLE_FLAG_UPTIME  0x01  // timestamp holds seconds since boot, not epoch seconds
+
+// A single timestamped sample waiting to be published
+struct QueuedSample {
+    uint32_t timestamp;  // Epoch seconds (or uptime seconds if SAMPLE_FLAG_UPTIME is set)
+    uint8_t metric;      // Index of the metric the value belongs to
+    uint8_t flags;
+    char value[14];      // Preformatted payload value
+};
+
+// Bounded FIFO of samples, kept in RAM and spilled to SPIFFS when RAM runs full.
+// Oldest samples always live in flash, so draining flash first preserves ordering.
+class OfflineQueue {
+public:
+    OfflineQueue(const char *spillPath);
+    void begin();                          // Mount SPIFFS and pick up unpublished samples left over from before a reboot
+    void push(const QueuedSample &sample); // Drops the oldest sample when RAM and flash are both full
+    bool peek(QueuedSample &sample);       // Oldest sample without removing it
+    void pop();                            // Remove the sample returned by the last peek()
+
+    size_t size() const;
+    bool empty() const;
+    uint32_t droppedCount() const;
+
+private:
+    const char *spillPath;
+    bool spillAvailable;
+
+    // RAM ring buffer
+    QueuedSample ring[OFFLINE_QUEUE_CAPACITY];
+    size_t ringHead;
+    size_t ringCount;
+
+    // Flash spill file state
+    size_t spillWritten;   // Samples appended to the spill file
+    size_t spillRead;      // Samples consumed from the spill file, saved to NVS after each read batch
+
+    // Samples read back from flash, consumed before touching the file again
+    QueuedSample readBuffer[OFFLINE_QUEUE_READ_BATCH];
+    size_t readBufferPos;
+    size_t readBufferCount;
+
+    // Samples in the spill file from before the last reboot. Their uptime timestamps belong
+    // to that boot and cannot be placed on the timeline, so those are dropped on the way out.
+    size_t previousBootSamples;
+
+    uint32_t dropped;
+
+    void spillOldest();
+    bool refillFromSpill();
+    void saveCursor(size_t cursor);
+    void removeSpill();
+};
+
+#endif // OFFLINE_QUEUE_H
@@ -0,0 +1,12 @@
+#ifndef SCREENSHOT_H
+#define SCREENSHOT_H
+
+#include <ESPAsyncWebServer.h>
+
+// /screenshot.bmp: the display shadow as an 8-bit BMP with an RGB332 palette (about 57 KB for
+// 240x240). The image is produced piece by piece as the TCP window allows, straight from the
+// shadow, without buffering it or taking a lock, so drawing is never held up. A screenshot taken
+// while the loop is redrawing can show parts of both frames.
+void setupScreenshot(AsyncWebServer &server);
+
+#endif // SCREENSHOT_H
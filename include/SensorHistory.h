@@ -0,0 +1,33 @@
+#ifndef SENSOR_HISTORY_H
+#define SENSOR_HISTORY_H
+
+#include <Arduino.h>
+#include <ESPAsyncWebServer.h>
+
+#define HISTORY_INTERVAL   60000  // Milliseconds between stored samples
+#define HISTORY_CAPACITY   1440   // Samples kept in RAM, 24 h at one per minute (12 bytes each)
+#define HISTORY_READ_BATCH 16     // Samples copied out of the ring per lock while exporting
+#define HISTORY_LINE_SIZE  96     // Longest CSV/JSON line
+
+// Metrics stored per sample, also the columns of the export
+enum class HistoryMetric : uint8_t {
+    Temperature,
+    Humidity,
+    MQ5Percentage,
+    WiFiSignal,
+    Count  // Number of metrics, keep last
+};
+
+// Store a sample if HISTORY_INTERVAL has passed since the last one. Call from the loop task.
+void recordSensorHistory(float temperature, float humidity, float mq5Percentage, int wifiSignalStrength);
+
+// /api/history?metric=&from=&to=&step=&format=
+//   metric  temperature, humidity, mq5 or rssi (default: all)
+//   from/to epoch seconds, or negative for seconds before now (default: everything stored)
+//   step    seconds per output point, samples in each step are averaged (default: every sample)
+//   format  csv (default) or json
+// Streamed with chunked encoding straight from the ring, with a fixed amount of memory per request
+// however long the range is.
+void setupSensorHistory(AsyncWebServer &server);
+
+#endif // SENSOR_HISTORY_H
@@ -0,0 +1,44 @@
+#ifndef SHADOWED_ST7789_H
+#define SHADOWED_ST7789_H
+
+#include <Adafruit_GFX.h>
+#include <Adafruit_ST7789.h>
+
+// Keep an RGB332 copy of the panel in RAM (240x240: 56 KB) for /screenshot.bmp
+#ifndef DISPLAY_SHADOW
+#define DISPLAY_SHADOW 1
+#endif
+
+// ST7789 driver that mirrors every pixel it sends into a shadow framebuffer, so the screen
+// contents can be read back without touching the SPI bus. All drawing in this project goes through
+// the pixel, line and rectangle primitives overridden here (text and bitmaps included).
+class ShadowedST7789 : public Adafruit_ST7789 {
+public:
+    ShadowedST7789(int8_t cs, int8_t dc, int8_t rst);
+
+    // Allocate the shadow after init(). Returns false if disabled or out of memory.
+    bool beginShadow();
+    bool hasShadow() const;
+    const uint8_t *shadowRow(int16_t y) const;  // width() bytes, RGB332
+
+    // 3 bits red, 3 bits green, 2 bits blue
+    static uint8_t toRGB332(uint16_t color);
+
+    void drawPixel(int16_t x, int16_t y, uint16_t color) override;
+    void writePixel(int16_t x, int16_t y, uint16_t color) override;
+    void fillRect(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color) override;
+    void writeFillRect(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color) override;
+    void drawFastHLine(int16_t x, int16_t y, int16_t w, uint16_t color) override;
+    void writeFastHLine(int16_t x, int16_t y, int16_t w, uint16_t color) override;
+    void drawFastVLine(int16_t x, int16_t y, int16_t h, uint16_t color) override;
+    void writeFastVLine(int16_t x, int16_t y, int16_t h, uint16_t color) override;
+
+private:
+    uint8_t *shadow;
+    int16_t shadowWidth;
+    int16_t shadowHeight;
+
+    void shadowRect(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color);
+};
+
+#endif // SHADOWED_ST7789_H
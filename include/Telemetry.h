@@ -0,0 +1,26 @@
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+#include <Arduino.h>
+#include <ESPAsyncWebServer.h>
+
+#define TELEMETRY_SAMPLE_INTERVAL  1000  // Milliseconds between snapshots taken by the loop task
+#define TELEMETRY_METRICS_SIZE     8192  // Prometheus text exposition
+#define TELEMETRY_STATE_SIZE       1536  // JSON
+#define TELEMETRY_ARENA_SLOTS      4     // Memory arenas reported
+
+// Machine-readable state for monitoring: Prometheus text on "/metrics" and JSON on "/api/state".
+// The loop task takes a snapshot at most once per TELEMETRY_SAMPLE_INTERVAL. Each endpoint renders
+// into a reusable buffer only when a request arrives after the snapshot changed, so frequent
+// scrapes just copy the last render out. Uptime, weather age, heap gauges and loop statistics
+// drift constantly and alone don't count as a change.
+void setupTelemetry(AsyncWebServer &server);
+
+// One pass of loop(): its time in microseconds and the heap allocations it made
+void recordLoopPass(uint32_t elapsed, uint32_t allocations);
+
+// Take a snapshot of the readings and counters. Call from the loop task.
+void updateTelemetry(float temperature, float humidity, float mq5Percentage, const char *gasQuality,
+                     bool gasAlarm, int wifiSignalStrength);
+
+#endif // TELEMETRY_H
@@ -0,0 +1,18 @@
+#ifndef WEATHER_BENCHMARK_H
+#define WEATHER_BENCHMARK_H
+
+#include <Adafruit_ST7789.h>
+#include "WeatherHttpSession.h"
+
+// Benchmark build, see the esp32dev-bench environment in platformio.ini
+#ifndef WEATHER_BENCHMARK
+#define WEATHER_BENCHMARK 0
+#endif
+
+#define WEATHER_BENCHMARK_ROUNDS 5
+
+// Fetch every tools/owm_standin.py scenario a few times and print parse time, heap use and
+// whether failures were handled as expected. Overwrites the stored weather snapshot.
+void runWeatherBenchmark(Adafruit_ST7789 &tft, WeatherHttpSession &session);
+
+#endif // WEATHER_BENCHMARK_H
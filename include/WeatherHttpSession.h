@@ -0,0 +1,128 @@
+#ifndef WEATHER_HTTP_SESSION_H
+#define WEATHER_HTTP_SESSION_H
+
+#include <Arduino.h>
+#include <WiFi.h>
+#include "MemArena.h"
+
+// API server, can be pointed at tools/owm_standin.py via build_flags
+#ifndef WEATHER_API_HOST
+#define WEATHER_API_HOST        "api.openweathermap.org"
+#endif
+#ifndef WEATHER_API_PORT
+#define WEATHER_API_PORT        80
+#endif
+#define WEATHER_HTTP_TIMEOUT    5000
+#define WEATHER_ETAG_LENGTH     64
+#define WEATHER_DATE_LENGTH     32
+
+// Reserved with the session. Holds the request and header lines while they are exchanged,
+// then the JSON documents the pages parse the body into.
+#define WEATHER_ARENA_SIZE          1280
+#define WEATHER_HTTP_REQUEST_SIZE   512   // Longest request, path and conditional headers included
+#define WEATHER_HTTP_LINE_SIZE      192   // Longer response header lines are cut
+#define WEATHER_HTTP_CLOSED         -2    // readLine(): the server closed the connection
+
+// API call budget shared by all weather requests (can be overridden via build_flags)
+#ifndef WEATHER_API_CALLS_PER_HOUR
+#define WEATHER_API_CALLS_PER_HOUR  30
+#endif
+#ifndef WEATHER_API_BURST
+#define WEATHER_API_BURST           6
+#endif
+
+// Validators and freshness of the last accepted response for one resource
+struct HttpCacheEntry {
+    char etag[WEATHER_ETAG_LENGTH];
+    char lastModified[WEATHER_DATE_LENGTH];
+    unsigned long fetchedAt;  // millis() when the response arrived
+    unsigned long maxAge;     // Cache-Control max-age in milliseconds, 0 if not cacheable
+
+    void clear() {
+        etag[0] = '\0';
+        lastModified[0] = '\0';
+        fetchedAt = 0;
+        maxAge = 0;
+    }
+};
+
+enum class HttpFetchResult : uint8_t {
+    Ok,           // New body, read it from body() before calling end()
+    NotModified,  // Server answered 304, the last body still applies
+    Fresh,        // Still within max-age, no request was made
+    Throttled,    // API call budget used up, no request was made
+    Failed
+};
+
+// Body of the current response, limited to Content-Length so the parser
+// can never read into the next response on a kept-alive connection
+class HttpBodyStream : public Stream {
+public:
+    HttpBodyStream();
+    void attach(Stream *source, int length);
+    int remaining() const;  // -1 if the length is unknown
+
+    int available() override;
+    int read() override;
+    int peek() override;
+    size_t readBytes(char *buffer, size_t length) override;
+    size_t write(uint8_t) override;
+
+private:
+    Stream *source;
+    int left;
+};
+
+// One keep-alive connection to the weather API shared by the current
+// weather and forecast requests. Conditional requests are sent with the stored
+// ETag / Last-Modified, so unchanged payloads cost a header round trip only.
+// The HTTP/1.0 exchange is done directly on the socket in the session's arena,
+// so a request takes nothing from the heap beyond the WiFiClient's own buffers.
+class WeatherHttpSession {
+public:
+    WeatherHttpSession(const char *host, uint16_t port);
+
+    // Starts a GET for path (e.g. "/data/2.5/weather?q=..."). Always pair with end().
+    HttpFetchResult get(const char *path, HttpCacheEntry &cache);
+    Stream &body();
+    void end();  // Drains any unread body so the connection can be reused
+    MemArena &arena();  // Empty between get() and end(), reset when the transaction ends
+
+    uint32_t requestCount() const;
+    uint32_t reusedCount() const;       // Requests that did not need a new TCP connection
+    uint32_t notModifiedCount() const;  // 304 answers plus requests skipped as still fresh
+    uint32_t failedCount() const;       // No Wi-Fi, no connection or an error status
+    uint32_t throttledCount() const;    // Skipped because the call budget was used up
+    bool hasBudget();                   // True if a request would currently be allowed
+
+private:
+    const char *host;
+    uint16_t port;
+    WiFiClient client;
+    HttpBodyStream bodyStream;
+    bool active;
+    bool keepAlive;   // The server keeps the connection open after this response
+
+    alignas(max_align_t) uint8_t arenaBuffer[WEATHER_ARENA_SIZE];
+    MemArena transactionArena;
+
+    uint32_t requests;
+    uint32_t reused;
+    uint32_t notModified;
+    uint32_t failed;
+    uint32_t throttled;
+
+    // Token bucket: one token per request, refilled at WEATHER_API_CALLS_PER_HOUR
+    uint8_t budget;
+    unsigned long budgetRefilledAt;
+
+    void refillBudget();
+    int exchange(const char *path, const HttpCacheEntry &cache, HttpCacheEntry &received, int &contentLength);
+    bool sendRequest(const char *path, const HttpCacheEntry &cache);
+    int readResponse(HttpCacheEntry &received, int &contentLength);
+    int readLine(char *line, size_t size);
+    bool waitForData(unsigned long timeout);
+    void storeValidators(HttpCacheEntry &cache, const HttpCacheEntry &received);
+};
+
+#endif // WEATHER_HTTP_SESSION_H
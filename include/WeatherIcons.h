@@ -0,0 +1,24 @@
+#ifndef WEATHER_ICONS_H
+#define WEATHER_ICONS_H
+
+#include <Arduino.h>
+#include <array>
+
+// OpenWeatherMap condition IDs (weather[0].id) span 200-804,
+// see https://openweathermap.org/weather-conditions
+#define CONDITION_ID_MIN 200
+#define CONDITION_ID_MAX 804
+
+struct ConditionIcons {
+    const uint16_t *day;
+    const uint16_t *night;
+};
+
+// Dense lookup table in flash, indexed by condition ID - CONDITION_ID_MIN.
+// Defined with the icon arrays in WeatherIcons.cpp, so each icon is stored once.
+extern const std::array<ConditionIcons, CONDITION_ID_MAX - CONDITION_ID_MIN + 1> conditionIconTable;
+
+// Icon for a condition ID, night selects the variant for "..n" icon codes
+const uint16_t *getConditionIcon(uint16_t conditionId, bool night);
+
+#endif // WEATHER_ICONS_H
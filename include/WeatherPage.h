@@ -3,100 +3,84 @@
 
 #include <Adafruit_GFX.h>
 #include <Adafruit_ST7789.h>
-#include <HTTPClient.h>
 #include <ArduinoJson.h>
+#include <limits.h>
+#include "JsonArena.h"
+#include "WeatherHttpSession.h"
 
 #include "../icons/celsius.h"
 #include "../icons/humidity.h"
 
-// Include your weather icon arrays
-#include "../icons/clouds_broken.h"
-#include "../icons/clouds_few.h"
-#include "../icons/clouds_scattered.h"
-#include "../icons/mist.h"
-#include "../icons/rainy.h"
-#include "../icons/snowflake.h"
-#include "../icons/sun.h"
-#include "../icons/thunderstorm.h"
+// Weather icon arrays and the condition ID lookup table
+#include "WeatherIcons.h"
 
-// Structure for mapping weather descriptions to icons
-struct WeatherIconMapping {
-    const char *description;
-    const uint16_t *icon;
-};
+#define WEATHER_DESCRIPTION_LENGTH 32
+#define WEATHER_PATH_LENGTH 160
+
+#define WEATHER_SNAPSHOT_MAGIC 0x57534E50  // "WSNP"
+#define WEATHER_SNAPSHOT_VERSION 1
+#define WEATHER_SNAPSHOT_NVS_INTERVAL 1800  // Seconds between NVS writes, limits flash wear
 
-// Define all weather conditions and their associated icons
-const WeatherIconMapping weatherIcons[] = {
-    {"clear sky", sun},
-    {"few clouds", clouds_few},
-    {"scattered clouds", clouds_scattered},
-    {"broken clouds", clouds_broken},
-    {"overcast clouds", clouds_scattered},
-    {"light rain", rainy},
-    {"moderate rain", rainy},
-    {"heavy intensity rain", rainy},
-    {"very heavy rain", rainy},
-    {"extreme rain", rainy},
-    {"shower rain", rainy},
-    {"thunderstorm with light rain", thunderstorm},
-    {"thunderstorm with rain", thunderstorm},
-    {"thunderstorm with heavy rain", thunderstorm},
-    {"light thunderstorm", thunderstorm},
-    {"heavy thunderstorm", thunderstorm},
-    {"ragged thunderstorm", thunderstorm},
-    {"thunderstorm with light drizzle", thunderstorm},
-    {"thunderstorm with drizzle", thunderstorm},
-    {"thunderstorm with heavy drizzle", thunderstorm},
-    {"light intensity drizzle", rainy},
-    {"drizzle", rainy},
-    {"heavy intensity drizzle", rainy},
-    {"light intensity drizzle rain", rainy},
-    {"drizzle rain", rainy},
-    {"heavy intensity drizzle rain", rainy},
-    {"shower rain and drizzle", rainy},
-    {"heavy shower rain and drizzle", rainy},
-    {"shower drizzle", rainy},
-    {"light snow", snowflake},
-    {"snow", snowflake},
-    {"heavy snow", snowflake},
-    {"sleet", snowflake},  // Assuming a new icon `snowy` for sleet
-    {"light shower sleet", snowflake},
-    {"shower sleet", snowflake},
-    {"light rain and snow", snowflake},
-    {"rain and snow", snowflake},
-    {"light shower snow", snowflake},
-    {"shower snow", snowflake},
-    {"heavy shower snow", snowflake},
-    {"mist", mist},
-    {"smoke", mist},
-    {"haze", mist},
-    {"dust", mist},
-    {"fog", mist},
-    {"sand", mist},
-    {"ash", mist},
-    {"squalls", mist},
-    {"tornado", thunderstorm}
+// Last parsed weather state. Kept in RTC memory across soft resets and OTA,
+// and in NVS across power cycles, so the page has data right after boot.
+struct WeatherSnapshot {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t conditionId;
+    uint32_t fetchedAt;      // Epoch seconds, 0 if the clock was not set
+    int32_t timezoneOffset;
+    float temperature;
+    float feelsLike;
+    float humidity;
+    bool isNight;
+    char description[WEATHER_DESCRIPTION_LENGTH];
+    uint32_t crc;            // CRC32 of all fields above
 };
 
 class WeatherPage {
 public:
-    WeatherPage(Adafruit_ST7789 &display, const char *apiKey, const char *city);
+    WeatherPage(Adafruit_ST7789 &display, WeatherHttpSession &session, const char *apiKey, const char *city);
     void setup();
     void update(bool forceRender);
+    int32_t getTimezoneOffset() const;  // Seconds east of UTC for the configured city
+
+    bool refresh();                         // Fetch now, returns false on failure
+    unsigned long dataAge() const;          // Milliseconds since the data was fetched, ULONG_MAX if none
+    unsigned long refreshInterval() const;  // Age after which the data counts as stale
+    unsigned long getLastParseTime() const; // Microseconds spent in the last parse, for benchmarks
+
+    WeatherSnapshot getSnapshot() const;
+    bool applySnapshot(const WeatherSnapshot &snapshot);  // Data fetched elsewhere, false if not newer
 
 private:
     Adafruit_ST7789 &tft;
+    WeatherHttpSession &session;
     const char *apiKey;
     const char *city;
-    String weatherDescription;
+    char path[WEATHER_PATH_LENGTH];  // Request path, formatted once in setup()
+    HttpCacheEntry cache;
+    char weatherDescription[WEATHER_DESCRIPTION_LENGTH];
+    uint16_t conditionId;  // OpenWeatherMap condition ID, e.g. 800 for clear sky
+    bool isNight;          // Icon code ends in "n"
+    int32_t timezoneOffset;
     float temperature;
     float feelsLike;
     float humidity;
 
+    JsonDocument filter;  // Fields kept from the API response, built once in setup()
+
     unsigned long lastUpdateTime;
+    uint32_t fetchedAt;       // Epoch seconds of the data shown, 0 if unknown
+    uint32_t snapshotSavedAt; // Epoch seconds of the last NVS write
+    bool hasData;
+    bool changed;             // Refreshed values not drawn yet
+    unsigned long lastParseTime;
     const unsigned long updateInterval = 300000;  // 5 minutes in milliseconds
 
-    void getWeather();
+    bool getWeather();
+    bool restoreSnapshot();
+    void loadSnapshotValues(const WeatherSnapshot &snapshot);
+    void saveSnapshot();
     void displayWeather();
     const uint16_t* getWeatherIcon();  // Helper to determine which icon to display
 };
@@ -0,0 +1,44 @@
+#ifndef WEATHER_REFRESH_POLICY_H
+#define WEATHER_REFRESH_POLICY_H
+
+#include <Arduino.h>
+#include <limits.h>
+#include "WeatherPage.h"
+#include "ForecastPage.h"
+#include "WeatherHttpSession.h"
+
+#define WEATHER_PREFETCH_LEAD     20000   // Fetch up to this long before a page rotates in
+#define WEATHER_RETRY_INTERVAL    60000   // Minimum time between attempts for one source after a failure
+#define WEATHER_NOT_SCHEDULED     ULONG_MAX
+
+enum class ScreenState : uint8_t {
+    On,
+    Dimmed,
+    Off
+};
+
+// Decides when weather and forecast data are fetched. Instead of refreshing on a
+// timer while a page is visible, data is fetched shortly before the page rotation
+// brings it up, so it is fresh when shown and nothing is fetched while nobody looks.
+class WeatherRefreshPolicy {
+public:
+    WeatherRefreshPolicy(WeatherPage &weather, ForecastPage &forecast, WeatherHttpSession &session);
+
+    // weatherDueIn / forecastDueIn: milliseconds until the page is shown, 0 while it is
+    // visible, WEATHER_NOT_SCHEDULED if the rotation will not bring it up
+    void loop(ScreenState screen, unsigned long weatherDueIn, unsigned long forecastDueIn);
+
+private:
+    WeatherPage &weather;
+    ForecastPage &forecast;
+    WeatherHttpSession &session;
+    unsigned long lastWeatherAttempt;
+    unsigned long lastForecastAttempt;
+    bool weatherFailed;
+    bool forecastFailed;
+
+    bool needsRefresh(ScreenState screen, unsigned long dueIn, unsigned long age, unsigned long interval,
+                      bool failed, unsigned long lastAttempt) const;
+};
+
+#endif // WEATHER_REFRESH_POLICY_H
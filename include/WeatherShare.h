@@ -0,0 +1,36 @@
+#ifndef WEATHER_SHARE_H
+#define WEATHER_SHARE_H
+
+#include <Arduino.h>
+#include "WeatherPage.h"
+
+// Share one weather fetch between several stations in the same city,
+// enable with build_flags = -DWEATHER_SHARE=1
+#ifndef WEATHER_SHARE
+#define WEATHER_SHARE 0
+#endif
+
+#define WEATHER_SHARE_STALE_AFTER      900   // Seconds before followers stop trusting the shared snapshot
+#define WEATHER_SHARE_TAKEOVER_SPREAD  120   // Seconds over which takeovers are spread, so one station wins
+#define WEATHER_SHARE_STARTUP_GRACE    10    // Seconds to wait for the retained snapshot after boot
+#define WEATHER_SHARE_PAYLOAD_LENGTH   192
+
+// One station (the leader) fetches the weather and publishes the parsed snapshot as a
+// compact retained message on <root>/shared/weather/<city>. The others render from it
+// and only fetch themselves once it goes stale; the first to do so becomes the new
+// leader. Takeover delays are ordered by client ID, and if two leaders collide the
+// lower client ID keeps the role.
+
+// Format the topic; call after setupDeviceIdentity and before setupMQTT
+void setupWeatherShare(const char *city);
+const char *getWeatherShareTopic();
+
+// Called from the MQTT callback for messages on the share topic
+void handleWeatherShareMessage(const uint8_t *payload, size_t length);
+
+bool isWeatherShareLeader();
+bool weatherShareShouldFetch();   // False while a fresh snapshot from another station is available
+bool takeSharedWeather(WeatherSnapshot &snapshot);  // New snapshot received since the last call
+void shareWeatherSnapshot(const WeatherSnapshot &snapshot);  // Publish after fetching
+
+#endif // WEATHER_SHARE_H
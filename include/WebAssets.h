@@ -0,0 +1,20 @@
+#ifndef WEB_ASSETS_H
+#define WEB_ASSETS_H
+
+#include <Arduino.h>
+#include <ESPAsyncWebServer.h>
+
+// A file from web/, gzipped at build time by tools/embed_web_assets.py
+struct WebAsset {
+    const char *path;         // URL, e.g. "/app.js"
+    const char *contentType;
+    const uint8_t *data;      // Gzipped, in flash
+    size_t length;
+    const char *etag;         // Quoted, derived from the gzipped bytes
+};
+
+// Serve every embedded asset (index.html also on "/") straight from flash with
+// Content-Encoding: gzip. Browsers revalidate with the ETag and get a 304 without a body.
+void setupWebAssets(AsyncWebServer &server);
+
+#endif // WEB_ASSETS_H
@@ -0,0 +1,99 @@
+// Generated by tools/embed_web_assets.py from web/, do not edit
+#ifndef WEB_ASSETS_DATA_H
+#define WEB_ASSETS_DATA_H
+
+#include "WebAssets.h"
+
+// /app.js: 627 bytes, 359 gzipped
+const uint8_t webAsset_app_js[] PROGMEM = {
+    0x1f, 0x8b, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0x03, 0x8d, 0x52, 0x41, 0x6a, 0xc3, 0x30,
+    0x10, 0xbc, 0xfb, 0x15, 0x7b, 0x08, 0xc8, 0x06, 0x47, 0xa1, 0x87, 0x5e, 0x62, 0xdc, 0x40, 0x4b,
+    0x0a, 0x2d, 0xa1, 0x85, 0xfa, 0x01, 0x45, 0xb1, 0xb6, 0xb1, 0x68, 0x22, 0xb9, 0x5a, 0xd9, 0x49,
+    0x28, 0xf9, 0x7b, 0xd7, 0x4a, 0x08, 0x49, 0x7b, 0xe9, 0x45, 0xbb, 0xcc, 0xce, 0x8e, 0x46, 0x83,
+    0x26, 0x13, 0x58, 0x98, 0x1e, 0xc1, 0xa3, 0xd2, 0xc6, 0xae, 0x08, 0xda, 0x8e, 0x1a, 0xd4, 0xb0,
+    0xdc, 0x43, 0x68, 0x10, 0x28, 0xa8, 0x60, 0x9c, 0x05, 0xd7, 0xa3, 0x87, 0x0a, 0x3d, 0x97, 0x71,
+    0x85, 0x36, 0xc0, 0xbc, 0xe7, 0x93, 0x92, 0xda, 0x59, 0x0a, 0x30, 0x82, 0x12, 0x8c, 0x86, 0xf2,
+    0x0e, 0xb4, 0xab, 0xbb, 0x0d, 0x4f, 0xe4, 0x0a, 0xc3, 0x7c, 0x8d, 0x43, 0x7b, 0xbf, 0x7f, 0xd2,
+    0xa9, 0xd1, 0x59, 0x71, 0x22, 0x53, 0xe3, 0xb6, 0xcc, 0x67, 0x28, 0x87, 0x3e, 0x07, 0x9d, 0x0d,
+    0x7b, 0xdf, 0x30, 0x1a, 0x38, 0x32, 0xe0, 0x2e, 0x3c, 0x38, 0x1b, 0x86, 0x2b, 0x4a, 0xe8, 0xa1,
+    0x2c, 0x4b, 0xb0, 0xdd, 0x7a, 0x0d, 0x33, 0x10, 0x63, 0x01, 0x53, 0x48, 0x75, 0xc4, 0x3a, 0xab,
+    0xf1, 0xc3, 0x58, 0x36, 0x3a, 0x63, 0xd6, 0x14, 0x7a, 0x19, 0xdc, 0xa3, 0xd9, 0xa1, 0x4e, 0x75,
+    0x96, 0x15, 0x70, 0x28, 0x92, 0xd3, 0x6d, 0x48, 0xac, 0x63, 0x71, 0x7b, 0x34, 0x5c, 0xb9, 0xce,
+    0xd7, 0x98, 0x8a, 0x09, 0x46, 0xfb, 0x82, 0x4d, 0x21, 0x49, 0x67, 0x5d, 0x8b, 0x76, 0xf0, 0x74,
+    0xf6, 0x22, 0x86, 0x87, 0xa3, 0xf8, 0x6d, 0x48, 0x0c, 0x59, 0x89, 0xa8, 0x1f, 0xf7, 0xd0, 0x7b,
+    0xe7, 0xff, 0xb5, 0xf8, 0x86, 0xec, 0xc7, 0x62, 0x1d, 0x38, 0x64, 0x29, 0xe5, 0x59, 0x43, 0x69,
+    0x1d, 0x9d, 0x2d, 0x0c, 0x31, 0x15, 0x3d, 0x0b, 0xa0, 0x25, 0xe7, 0x49, 0xe4, 0x80, 0x51, 0x34,
+    0x01, 0x38, 0x05, 0xc7, 0x3a, 0xcf, 0xd5, 0xeb, 0x8b, 0x6c, 0x95, 0x27, 0x4c, 0x51, 0x6a, 0x15,
+    0x14, 0xbf, 0x00, 0x62, 0xa4, 0xa9, 0x08, 0xbc, 0x42, 0x32, 0xe4, 0x70, 0x73, 0x01, 0x36, 0x11,
+    0x6c, 0xae, 0xc1, 0xcd, 0xd7, 0x6d, 0x84, 0xb9, 0x5e, 0x0f, 0x56, 0x8a, 0xe2, 0x80, 0xeb, 0x05,
+    0xea, 0x89, 0x4c, 0x84, 0x87, 0xe6, 0x52, 0x1b, 0x55, 0x7b, 0x94, 0xe7, 0xe6, 0xfd, 0x73, 0x19,
+    0x47, 0x1c, 0x01, 0x7f, 0x92, 0x3f, 0x01, 0x90, 0x64, 0xb4, 0x48, 0x0e, 0xcc, 0xf9, 0x01, 0xe8,
+    0x77, 0x71, 0x36, 0x73, 0x02, 0x00, 0x00,
+};
+
+// /index.html: 1276 bytes, 551 gzipped
+const uint8_t webAsset_index_html[] PROGMEM = {
+    0x1f, 0x8b, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0x03, 0xa5, 0x94, 0x61, 0x8b, 0x13, 0x31,
+    0x10, 0x86, 0xbf, 0xf7, 0x57, 0xc4, 0x80, 0xa2, 0xe0, 0x76, 0xbd, 0x62, 0x8b, 0xe2, 0xee, 0xc2,
+    0xdd, 0x69, 0x39, 0x10, 0xb9, 0x93, 0x3b, 0x39, 0x44, 0xfc, 0x30, 0xcd, 0x4e, 0xbb, 0xa3, 0xd9,
+    0xdd, 0x5c, 0x32, 0xdb, 0x5a, 0xc5, 0xff, 0xee, 0x6c, 0x5a, 0xb5, 0x55, 0x90, 0x16, 0xbf, 0x6c,
+    0xc8, 0x3b, 0x6f, 0xe6, 0xc9, 0x64, 0x33, 0xc9, 0xee, 0xbd, 0xbc, 0x3c, 0xbf, 0x79, 0x7f, 0xf5,
+    0x4a, 0x55, 0x5c, 0xdb, 0x62, 0x90, 0xc5, 0x21, 0xab, 0x10, 0xca, 0x22, 0xab, 0x91, 0x41, 0x99,
+    0x0a, 0x7c, 0x40, 0xce, 0x75, 0xc7, 0xf3, 0xe4, 0x99, 0xde, 0xaa, 0x0d, 0xd4, 0x98, 0xeb, 0x25,
+    0xe1, 0xca, 0xb5, 0x9e, 0xb5, 0x32, 0x6d, 0xc3, 0xd8, 0x88, 0x6b, 0x45, 0x25, 0x57, 0x79, 0x89,
+    0x4b, 0x32, 0x98, 0xc4, 0xc9, 0x63, 0x6a, 0x88, 0x09, 0x6c, 0x12, 0x0c, 0x58, 0xcc, 0x4f, 0xb4,
+    0x50, 0x98, 0xd8, 0x62, 0x71, 0x8b, 0xc0, 0x15, 0x7a, 0x75, 0xcd, 0xc0, 0xd4, 0x36, 0x59, 0xba,
+    0x91, 0x07, 0x99, 0xa5, 0xe6, 0xb3, 0xf2, 0x68, 0x73, 0x1d, 0x78, 0x6d, 0x31, 0x54, 0x88, 0xc2,
+    0xa8, 0x3c, 0xce, 0x73, 0x9d, 0x46, 0x69, 0x68, 0x42, 0xe8, 0x13, 0xa5, 0x9b, 0x9d, 0xce, 0xda,
+    0x72, 0xdd, 0x6f, 0xfe, 0xe4, 0xef, 0x9c, 0xa2, 0x0d, 0x32, 0xa7, 0xa8, 0xec, 0x93, 0x01, 0xa3,
+    0x2e, 0xce, 0xdb, 0xa6, 0x41, 0xc3, 0xd4, 0x2c, 0x86, 0xc3, 0x61, 0x96, 0x3a, 0x89, 0x97, 0xb4,
+    0x54, 0xc6, 0x42, 0x08, 0xb9, 0x5e, 0x78, 0x2a, 0xf5, 0xbe, 0x64, 0xc0, 0x8b, 0xb4, 0xab, 0x58,
+    0x98, 0xa1, 0xd5, 0xc5, 0x0d, 0xd6, 0x0e, 0x3d, 0x70, 0xe7, 0x31, 0x4b, 0x25, 0xbc, 0xe7, 0x59,
+    0x82, 0xed, 0x84, 0x96, 0x05, 0x07, 0x4d, 0xc4, 0xb3, 0x2e, 0x92, 0x2c, 0xed, 0xa7, 0x85, 0x7a,
+    0x50, 0xe2, 0xe2, 0xc5, 0xf9, 0x76, 0x51, 0xfc, 0x1e, 0x46, 0xbc, 0xe8, 0x6a, 0x2a, 0x89, 0xd7,
+    0x07, 0xe0, 0xaa, 0x1d, 0xdc, 0xfd, 0xe3, 0x49, 0x6f, 0xde, 0x26, 0xe3, 0x03, 0x28, 0xf5, 0xdd,
+    0xf8, 0xff, 0x38, 0xa7, 0xe4, 0xd5, 0x5d, 0x07, 0xf6, 0x1f, 0x45, 0x45, 0xd0, 0x02, 0x42, 0x04,
+    0x1d, 0x9b, 0xff, 0x96, 0x92, 0x29, 0x1d, 0x50, 0x88, 0x0f, 0x81, 0x76, 0x2a, 0x29, 0xcf, 0xea,
+    0xe3, 0x59, 0x53, 0x8f, 0xa8, 0xe4, 0x46, 0xba, 0x43, 0x7e, 0x8f, 0xd8, 0x76, 0x78, 0xaf, 0xcf,
+    0xf6, 0x71, 0xdb, 0xa1, 0x1a, 0x15, 0x53, 0xf2, 0xf5, 0x0a, 0x3c, 0xaa, 0xdf, 0x6b, 0x97, 0xe8,
+    0x25, 0xd5, 0x66, 0xa5, 0xdc, 0xf0, 0x91, 0x18, 0xe7, 0xad, 0xaf, 0x95, 0xb4, 0x66, 0xd5, 0x4a,
+    0xfc, 0xea, 0xf2, 0xfa, 0x46, 0x2b, 0x30, 0x7d, 0x07, 0x48, 0xc7, 0x74, 0xae, 0xec, 0x2f, 0xbe,
+    0xc2, 0xc6, 0xf0, 0xda, 0x49, 0xdf, 0xd6, 0x9d, 0x65, 0x72, 0xe0, 0x39, 0xed, 0x97, 0x25, 0x12,
+    0x85, 0xfe, 0xca, 0x53, 0xe3, 0x3a, 0x56, 0x1b, 0x0b, 0xe3, 0x17, 0x69, 0xb9, 0x4d, 0x9b, 0x87,
+    0x0a, 0x46, 0xe3, 0x89, 0x56, 0xce, 0x82, 0xc1, 0xaa, 0xb5, 0x25, 0xfa, 0x5c, 0x5f, 0x5f, 0x9c,
+    0x26, 0xa2, 0xaa, 0x87, 0xad, 0xeb, 0x31, 0x60, 0x1f, 0x69, 0x15, 0xe8, 0xab, 0xd8, 0x27, 0xbd,
+    0x15, 0x98, 0xd1, 0x0b, 0xfc, 0xc3, 0x93, 0xe4, 0x39, 0x24, 0xf3, 0xd3, 0x64, 0xfa, 0xf1, 0xdb,
+    0xe4, 0xe9, 0xf7, 0x3f, 0x31, 0x73, 0xb2, 0xf8, 0x13, 0x33, 0xdf, 0x16, 0xaa, 0x0b, 0xb5, 0xe7,
+    0x09, 0xdd, 0xac, 0x26, 0xd9, 0x4c, 0x3c, 0xc2, 0x5c, 0xbf, 0x8b, 0xd5, 0xa8, 0xe9, 0x2f, 0xb7,
+    0x1c, 0x56, 0x5f, 0x86, 0x8c, 0xc1, 0x78, 0x72, 0xac, 0x82, 0x37, 0x52, 0x35, 0x38, 0x37, 0xfc,
+    0x14, 0xe2, 0x39, 0x45, 0xb9, 0xf7, 0xc5, 0x77, 0x42, 0x4e, 0x2c, 0xbe, 0x75, 0x3f, 0x00, 0x89,
+    0xc7, 0x61, 0x83, 0xfc, 0x04, 0x00, 0x00,
+};
+
+// /style.css: 326 bytes, 227 gzipped
+const uint8_t webAsset_style_css[] PROGMEM = {
+    0x1f, 0x8b, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0x03, 0x7d, 0x8f, 0xdd, 0x6a, 0xc3, 0x30,
+    0x0c, 0x46, 0xef, 0xf7, 0x1a, 0xb9, 0x69, 0xa1, 0x0e, 0x75, 0xd8, 0x4a, 0x23, 0x3f, 0x8d, 0x12,
+    0x2b, 0xc1, 0xcc, 0x7f, 0xc8, 0x76, 0x49, 0x16, 0xf6, 0xee, 0x75, 0x08, 0x1d, 0xbd, 0xda, 0x8d,
+    0x40, 0xe2, 0xe8, 0xd3, 0xd1, 0x10, 0xf4, 0xba, 0x4d, 0xc1, 0x67, 0x31, 0xa1, 0x33, 0x76, 0x85,
+    0x84, 0x3e, 0x89, 0x44, 0x6c, 0x26, 0xe5, 0x90, 0x67, 0xe3, 0xe1, 0xaa, 0x22, 0x6a, 0x6d, 0xfc,
+    0x0c, 0xf2, 0x16, 0x17, 0x35, 0xe0, 0xf8, 0x3d, 0x73, 0x28, 0x5e, 0x43, 0x23, 0xa5, 0x54, 0x63,
+    0xb0, 0x81, 0xa1, 0x21, 0xa2, 0xdf, 0x8f, 0x76, 0x66, 0xa3, 0x37, 0x6d, 0x52, 0xb4, 0xb8, 0xc2,
+    0xde, 0xa8, 0xbd, 0x88, 0x4c, 0xae, 0x4e, 0x32, 0x89, 0x0a, 0x17, 0xe7, 0x13, 0x30, 0x45, 0xc2,
+    0x7c, 0xc2, 0x92, 0x83, 0x98, 0x8c, 0xb5, 0x17, 0x67, 0xbc, 0xc3, 0xe5, 0x24, 0xbf, 0xae, 0x71,
+    0xb9, 0xc8, 0x89, 0xcf, 0x67, 0x35, 0x63, 0x04, 0xd9, 0xc5, 0xa5, 0xc6, 0x8e, 0xc8, 0x7a, 0x7b,
+    0x3f, 0xdc, 0x75, 0x9d, 0x1a, 0x02, 0x6b, 0x62, 0xc1, 0xa8, 0x4d, 0x49, 0x70, 0xaf, 0x6a, 0x7f,
+    0x9e, 0xc7, 0x96, 0xc5, 0x81, 0xec, 0xf1, 0x5c, 0x32, 0x3f, 0x04, 0xed, 0x9d, 0xdc, 0x4b, 0xb7,
+    0xef, 0xfb, 0x4a, 0x3c, 0xd0, 0x16, 0x7a, 0x23, 0x64, 0x7b, 0xab, 0xc8, 0xf1, 0xb7, 0xc8, 0x21,
+    0xc2, 0xe7, 0x1e, 0xd4, 0xa4, 0x5c, 0xdd, 0xff, 0x0b, 0x7a, 0x02, 0x27, 0xed, 0x3a, 0xa5, 0x46,
+    0x01, 0x00, 0x00,
+};
+
+const WebAsset webAssets[] = {
+    {"/app.js", "application/javascript", webAsset_app_js, sizeof(webAsset_app_js), "\"2694e71f5a2a8db1\""},
+    {"/index.html", "text/html", webAsset_index_html, sizeof(webAsset_index_html), "\"0be237293f21e64c\""},
+    {"/style.css", "text/css", webAsset_style_css, sizeof(webAsset_style_css), "\"3a77104a8dfd627f\""},
+};
+const size_t webAssetCount = sizeof(webAssets) / sizeof(webAssets[0]);
+
+#endif // WEB_ASSETS_DATA_H
@@ -0,0 +1,18 @@
+#ifndef WEB_DASHBOARD_H
+#define WEB_DASHBOARD_H
+
+#include <Arduino.h>
+#include <ESPAsyncWebServer.h>
+
+#define DASHBOARD_BUFFER_SIZE   256
+#define DASHBOARD_MIN_INTERVAL  1000  // Milliseconds between pushes, however often values change
+
+// Server-Sent Events on "/events" feeding the dashboard page (web/index.html). Each change is
+// formatted once into a shared buffer and queued to every connected browser, so open tabs do not poll.
+void setupWebDashboard(AsyncWebServer &server);
+
+// Push the current readings if they differ from the last push. Call from the loop task.
+void updateDashboard(float temperature, float humidity, float mq5Percentage, const char *gasQuality,
+                     int wifiSignalStrength, uint32_t freeHeap);
+
+#endif // WEB_DASHBOARD_H
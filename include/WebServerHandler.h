@@ -1,7 +1,28 @@
 #ifndef WEB_SERVER_HANDLER_H
 #define WEB_SERVER_HANDLER_H
 
+#include "OTAProgressView.h"
+
+// Firmware uploads are hashed while they stream to flash. A digest sent in this header, or as a
+// "sha256" query or form field, must match before the image is made bootable.
+#define WEB_UPDATE_DIGEST_HEADER  "X-Firmware-SHA256"
+#define WEB_UPDATE_DIGEST_LENGTH  64  // Hex digits
+
+// Reject uploads that come without a digest
+#ifndef WEB_UPDATE_REQUIRE_SHA256
+#define WEB_UPDATE_REQUIRE_SHA256 0
+#endif
+
+// Request handlers run on the AsyncTCP task (network core) and never touch the display
 void setupWebServer(const char* webAuthUser, const char* webAuthPass);
+
+// Deferred work from the handlers, call from loop() (restart after a successful update)
 void handleWebServer();
 
+// True from the start of a firmware upload until it fails or the board restarts
+bool isWebUpdateInProgress();
+
+// Draw the firmware upload status, loop task only. Returns true while it owns the screen.
+bool updateWebUpdateScreen(OTAProgressView &progressView, bool forceRender);
+
 #endif
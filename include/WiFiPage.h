@@ -5,25 +5,35 @@
 #include <Adafruit_ST7789.h>
 #include <WiFi.h>
 
+// Station network details in fixed buffers, so reading them every pass does not touch the heap
+struct NetworkInfo {
+    char ssid[33];
+    char ip[16];
+    char mac[18];
+    int rssi;
+};
+
+void readNetworkInfo(NetworkInfo &info);
+
 class WiFiPage {
 public:
     WiFiPage(Adafruit_ST7789 &display);
     void setup();
     void update(bool forceRender = false);
-    String formatMemory(size_t bytes);
 
 private:
     Adafruit_ST7789 &tft;
     
-    String lastSsid;
-    String lastIp;
-    String lastMac;
-    int lastRssi;
+    NetworkInfo last;
     int lastCpuFreq;
-    String lastFreeMem;
+    char lastFreeMem[16];
+    char lastLargestBlock[32];
+    char lastMinFreeMem[16];
+    char lastAllocations[40];
     
     void displayInfo(bool forceRender);
     int rssiToPercent(int rssi);
+    void drawLine(int16_t y, const char *label, const char *value, char *last, size_t lastSize, bool forceRender);
 };
 
 #endif
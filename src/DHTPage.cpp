@@ -20,8 +20,8 @@
 // Forward declaration of the function to draw the Celsius bitmap
 void drawBitmapIcon(Adafruit_ST7789 &tft, int16_t x, int16_t y, const uint16_t *bitmap, int16_t w, int16_t h);
 
-DHTPage::DHTPage(Adafruit_ST7789 &display)
-    : tft(display), dht(DHT_PIN, DHT_TYPE) {}
+DHTPage::DHTPage(Adafruit_ST7789 &display, GasAlarm &gasAlarm)
+    : tft(display), gasAlarm(gasAlarm), dht(DHT_PIN, DHT_TYPE) {}
 
 void DHTPage::setup() {
     tft.fillScreen(ST77XX_BLACK);
@@ -35,15 +35,7 @@ void DHTPage::setup() {
 }
 
 float DHTPage::readMQ5() {
-    return analogRead(MQ5_PIN); // Returns a value from 0 to 4095 for ESP32
-}
-
-String DHTPage::determineGasQuality(float mq5Percentage) {
-    if (mq5Percentage < 25) return "Excellent";
-    if (mq5Percentage < 35) return "Good";
-    if (mq5Percentage < 55) return "OK";
-    if (mq5Percentage < 65) return "Bad";
-    return "Danger";
+    return gasAlarm.getPercentage(); // Latest sample from the gas alarm task, 0-100%
 }
 
 void DHTPage::update(bool forceRender) {
@@ -56,9 +48,8 @@ void DHTPage::update(bool forceRender) {
     }
 
     // Read MQ5 gas quality
-    float mq5Value = readMQ5();
-    float mq5Percentage = (mq5Value / 4095.0) * 100;  // Convert to percentage
-    String gasQuality = determineGasQuality(mq5Percentage);
+    float mq5Percentage = readMQ5();
+    GasQuality gasQuality = classifyGasQuality(mq5Percentage);
 
     if (forceRender || 
         temperature != lastTemperature || 
@@ -68,7 +59,7 @@ void DHTPage::update(bool forceRender) {
     }
 }
 
-void DHTPage::updateDisplay(int temperature, int humidity, const String& gasQuality, bool forceRender) {
+void DHTPage::updateDisplay(int temperature, int humidity, GasQuality gasQuality, bool forceRender) {
     // Draw the temperature icon and value at the top left of the screen
     int16_t iconX = 30; // Fixed horizontal position for the temperature icon
     int16_t iconY = 10; // Fixed vertical position near the top (10 pixels from the top)
@@ -111,13 +102,13 @@ void DHTPage::updateDisplay(int temperature, int humidity, const String& gasQual
     // Clear and update air quality if it has changed or if forceRender is true
     if (forceRender || gasQuality != lastGasQuality) {
         tft.fillRect(10, SCREEN_HEIGHT - 80, 220, 80, ST77XX_BLACK); // Clear previous air quality area with color
-        String airQualityLabel = "Air Quality:";
-        String airQualityValue = gasQuality;
+        const char* airQualityLabel = "Air Quality:";
+        const char* airQualityValue = gasQualityName(gasQuality);
 
         // Calculate width for each line of text
         const uint8_t CHAR_WIDTH = 9; // Width based on font size
-        uint16_t labelWidth = airQualityLabel.length() * CHAR_WIDTH * 2; // Width for the label
-        uint16_t valueWidth = airQualityValue.length() * CHAR_WIDTH * 2; // Width for the value
+        uint16_t labelWidth = strlen(airQualityLabel) * CHAR_WIDTH * 2; // Width for the label
+        uint16_t valueWidth = strlen(airQualityValue) * CHAR_WIDTH * 2; // Width for the value
 
         // Calculate positions to center the text
         int16_t labelCenterX = (SCREEN_WIDTH - labelWidth) / 2; // Center for label
@@ -136,7 +127,7 @@ void DHTPage::updateDisplay(int temperature, int humidity, const String& gasQual
     lastGasQuality = gasQuality; 
 }
 
-void DHTPage::updateDisplay(const String& message) {
+void DHTPage::updateDisplay(const char* message) {
     tft.fillRect(10, 10, 220, 30, ST77XX_BLACK); 
     tft.setCursor(10, 10);
     tft.println(message);
@@ -175,13 +166,10 @@ float DHTPage::getHumidity() {
 }
 
 // Getter for gas quality to be used in main for MQTT
-String DHTPage::getGasQuality() {
-    float mq5Value = readMQ5();
-    float mq5Percentage = (mq5Value / 4095.0) * 100;
-    return determineGasQuality(mq5Percentage);
+GasQuality DHTPage::getGasQuality() {
+    return classifyGasQuality(readMQ5());
 }
 
 float DHTPage::getMQ5Percentage() {
-    float mq5Value = readMQ5();
-    return (mq5Value / 4095.0) * 100;  // Convert to percentage
+    return readMQ5();
 }
\ No newline at end of file
@@ -0,0 +1,264 @@
+#include "DeltaUpdate.h"
+#include <Update.h>
+#include <esp_ota_ops.h>
+
+// Little-endian u32 from the patch
+static uint32_t readUint32(const uint8_t *data) {
+    return data[0] | (data[1] << 8) | (data[2] << 16) | ((uint32_t)data[3] << 24);
+}
+
+DeltaUpdate::DeltaUpdate()
+    : stage(Stage::Failed), error(""), source(nullptr), inflator(nullptr), window(nullptr),
+      windowPosition(0), streamEnded(false), collected(0), sourceSize(0), targetLength(0), produced(0),
+      sourceOffset(0), diffLeft(0), extraLeft(0) {
+    mbedtls_sha256_init(&targetHash);
+}
+
+DeltaUpdate::~DeltaUpdate() {
+    release();
+}
+
+bool DeltaUpdate::begin() {
+    release();
+    stage = Stage::Header;
+    error = "";
+    collected = 0;
+    targetLength = 0;
+    produced = 0;
+    windowPosition = 0;
+    streamEnded = false;
+
+    source = esp_ota_get_running_partition();
+    inflator = (tinfl_decompressor *)malloc(sizeof(tinfl_decompressor));
+    window = (uint8_t *)malloc(TINFL_LZ_DICT_SIZE);
+    if (source == nullptr || inflator == nullptr || window == nullptr) {
+        return fail("Not enough memory");
+    }
+    tinfl_init(inflator);
+    mbedtls_sha256_init(&targetHash);
+    mbedtls_sha256_starts(&targetHash, 0);  // 0: SHA-256, not SHA-224
+    return true;
+}
+
+bool DeltaUpdate::write(const uint8_t *data, size_t len) {
+    if (stage == Stage::Failed) {
+        return false;
+    }
+
+    // The header is not compressed
+    if (stage == Stage::Header) {
+        size_t take = min(len, DELTA_HEADER_SIZE - collected);
+        memcpy(header + collected, data, take);
+        collected += take;
+        data += take;
+        len -= take;
+        if (collected < DELTA_HEADER_SIZE) {
+            return true;
+        }
+        if (!parseHeader()) {
+            return false;
+        }
+    }
+    return len == 0 || inflate(data, len);
+}
+
+bool DeltaUpdate::end() {
+    if (stage == Stage::Failed) {
+        return false;
+    }
+    if (!streamEnded || stage != Stage::Command || collected != 0 || produced != targetLength) {
+        return fail("Patch is incomplete");
+    }
+
+    uint8_t digest[32];
+    mbedtls_sha256_finish(&targetHash, digest);
+    if (memcmp(digest, header + 44, sizeof(digest)) != 0) {
+        return fail("Image SHA-256 mismatch");
+    }
+    if (!Update.end(true)) {
+        return fail(Update.errorString());
+    }
+
+    stage = Stage::Done;
+    release();
+    return true;
+}
+
+void DeltaUpdate::abort() {
+    if (stage != Stage::Done && stage != Stage::Failed) {
+        fail("Aborted");
+    }
+    release();
+}
+
+const char *DeltaUpdate::errorString() const {
+    return error;
+}
+
+size_t DeltaUpdate::targetSize() const {
+    return targetLength;
+}
+
+size_t DeltaUpdate::written() const {
+    return produced;
+}
+
+bool DeltaUpdate::fail(const char *reason) {
+    if (Update.isRunning()) {
+        Update.abort();
+    }
+    stage = Stage::Failed;
+    error = reason;
+    release();
+    return false;
+}
+
+void DeltaUpdate::release() {
+    free(inflator);
+    free(window);
+    inflator = nullptr;
+    window = nullptr;
+    mbedtls_sha256_free(&targetHash);  // Also releases the SHA peripheral
+}
+
+bool DeltaUpdate::parseHeader() {
+    if (memcmp(header, DELTA_MAGIC, 4) != 0) {
+        return fail("Not a delta patch");
+    }
+    sourceSize = readUint32(header + 4);
+    targetLength = readUint32(header + 40);
+    if (sourceSize > source->size) {
+        return fail("Patch is for another image");
+    }
+    if (!verifySource()) {
+        return false;
+    }
+    if (!Update.begin(targetLength)) {
+        return fail(Update.errorString());
+    }
+    stage = Stage::Command;
+    collected = 0;
+    return true;
+}
+
+// The patch only fits the exact image it was made from
+bool DeltaUpdate::verifySource() {
+    mbedtls_sha256_context sourceHash;
+    mbedtls_sha256_init(&sourceHash);
+    mbedtls_sha256_starts(&sourceHash, 0);
+    for (uint32_t offset = 0; offset < sourceSize; offset += DELTA_SOURCE_CHUNK) {
+        size_t chunk = min<uint32_t>(DELTA_SOURCE_CHUNK, sourceSize - offset);
+        if (esp_partition_read(source, offset, sourceBuffer, chunk) != ESP_OK) {
+            mbedtls_sha256_free(&sourceHash);
+            return fail("Flash read failed");
+        }
+        mbedtls_sha256_update(&sourceHash, sourceBuffer, chunk);
+    }
+    uint8_t digest[32];
+    mbedtls_sha256_finish(&sourceHash, digest);
+    mbedtls_sha256_free(&sourceHash);
+
+    if (memcmp(digest, header + 8, sizeof(digest)) != 0) {
+        return fail("Patch is for another image");
+    }
+    return true;
+}
+
+bool DeltaUpdate::parseCommand() {
+    sourceOffset = readUint32(command);
+    diffLeft = readUint32(command + 4);
+    extraLeft = readUint32(command + 8);
+    collected = 0;
+
+    if (sourceOffset > sourceSize || diffLeft > sourceSize - sourceOffset ||
+        (uint64_t)produced + diffLeft + extraLeft > targetLength) {
+        return fail("Corrupt patch");
+    }
+    stage = diffLeft > 0 ? Stage::Diff : extraLeft > 0 ? Stage::Extra : Stage::Command;
+    return true;
+}
+
+// Inflate into the wrapping window and hand every piece of output to consume()
+bool DeltaUpdate::inflate(const uint8_t *data, size_t len) {
+    while (!streamEnded) {
+        size_t inBytes = len;
+        size_t outBytes = TINFL_LZ_DICT_SIZE - windowPosition;
+        tinfl_status status = tinfl_decompress(inflator, data, &inBytes, window, window + windowPosition, &outBytes,
+                                               TINFL_FLAG_PARSE_ZLIB_HEADER | TINFL_FLAG_HAS_MORE_INPUT);
+        data += inBytes;
+        len -= inBytes;
+
+        if (outBytes > 0 && !consume(window + windowPosition, outBytes)) {
+            return false;
+        }
+        windowPosition = (windowPosition + outBytes) & (TINFL_LZ_DICT_SIZE - 1);
+
+        if (status == TINFL_STATUS_DONE) {
+            streamEnded = true;
+        } else if (status < TINFL_STATUS_DONE) {
+            return fail("Corrupt patch");
+        } else if (status == TINFL_STATUS_NEEDS_MORE_INPUT && len == 0) {
+            return true;
+        }
+    }
+
+    return len == 0 || fail("Data after the end of the patch");
+}
+
+// Run decompressed patch bytes through the command stream
+bool DeltaUpdate::consume(const uint8_t *data, size_t len) {
+    while (len > 0) {
+        if (stage == Stage::Command) {
+            size_t take = min(len, DELTA_COMMAND_SIZE - collected);
+            memcpy(command + collected, data, take);
+            collected += take;
+            data += take;
+            len -= take;
+            if (collected == DELTA_COMMAND_SIZE && !parseCommand()) {
+                return false;
+            }
+        } else if (stage == Stage::Diff) {
+            // Target byte = source byte + diff byte
+            size_t take = min<size_t>(min<size_t>(len, diffLeft), DELTA_SOURCE_CHUNK);
+            if (esp_partition_read(source, sourceOffset, sourceBuffer, take) != ESP_OK) {
+                return fail("Flash read failed");
+            }
+            for (size_t i = 0; i < take; i++) {
+                sourceBuffer[i] += data[i];
+            }
+            if (!output(sourceBuffer, take)) {
+                return false;
+            }
+            sourceOffset += take;
+            diffLeft -= take;
+            data += take;
+            len -= take;
+            if (diffLeft == 0) {
+                stage = extraLeft > 0 ? Stage::Extra : Stage::Command;
+            }
+        } else if (stage == Stage::Extra) {
+            size_t take = min<size_t>(len, extraLeft);
+            if (!output(data, take)) {
+                return false;
+            }
+            extraLeft -= take;
+            data += take;
+            len -= take;
+            if (extraLeft == 0) {
+                stage = Stage::Command;
+            }
+        } else {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool DeltaUpdate::output(const uint8_t *data, size_t len) {
+    mbedtls_sha256_update(&targetHash, data, len);
+    if (Update.write(const_cast<uint8_t *>(data), len) != len) {
+        return fail(Update.errorString());
+    }
+    produced += len;
+    return true;
+}
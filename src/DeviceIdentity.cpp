@@ -0,0 +1,38 @@
+#include "DeviceIdentity.h"
+
+char deviceId[DEVICE_ID_MAX_LENGTH + 1];
+char hostname[DEVICE_STRING_LENGTH];
+char mqttClientId[DEVICE_STRING_LENGTH];
+char topicPrefix[DEVICE_STRING_LENGTH];
+
+void setupDeviceIdentity() {
+    // Factory MAC, lowest byte first
+    uint64_t mac = ESP.getEfuseMac();
+    char macSuffix[7];
+    snprintf(macSuffix, sizeof(macSuffix), "%02x%02x%02x",
+             (uint8_t)(mac >> 24), (uint8_t)(mac >> 32), (uint8_t)(mac >> 40));
+
+    strlcpy(deviceId, strlen(DEVICE_NAME) > 0 ? DEVICE_NAME : macSuffix, sizeof(deviceId));
+
+    snprintf(hostname, sizeof(hostname), "weatherstation-%s", deviceId);
+    snprintf(mqttClientId, sizeof(mqttClientId), "weatherstation-%s", macSuffix);
+    snprintf(topicPrefix, sizeof(topicPrefix), "%s/%s", MQTT_TOPIC_ROOT, deviceId);
+
+    Serial.printf("Device: %s (client ID %s, topics %s/...)\n", hostname, mqttClientId, topicPrefix);
+}
+
+const char* getDeviceId() {
+    return deviceId;
+}
+
+const char* getHostname() {
+    return hostname;
+}
+
+const char* getMqttClientId() {
+    return mqttClientId;
+}
+
+const char* getTopicPrefix() {
+    return topicPrefix;
+}
@@ -0,0 +1,264 @@
+#include "ForecastPage.h"
+#include <Preferences.h>
+#include <time.h>
+
+// OpenWeatherMap 5 day / 3 hour forecast path
+const char *forecastPathFormat = "/data/2.5/forecast?q=%s&appid=%s&units=metric";
+
+// Condition IDs seen during one day, used to pick the dominant condition
+struct DayTally {
+    uint16_t ids[8];
+    uint8_t counts[8];
+    uint8_t used;
+};
+
+// Higher values win ties between equally frequent conditions
+static int conditionSeverity(uint16_t id) {
+    if (id < 300) return 6;              // Thunderstorm
+    if (id >= 600 && id < 700) return 5; // Snow
+    if (id >= 500 && id < 600) return 4; // Rain
+    if (id < 400) return 3;              // Drizzle
+    if (id < 800) return 2;              // Atmosphere
+    if (id > 800) return 1;              // Clouds
+    return 0;                            // Clear
+}
+
+static void tallyCondition(DayTally &tally, uint16_t id) {
+    for (uint8_t i = 0; i < tally.used; i++) {
+        if (tally.ids[i] == id) {
+            tally.counts[i]++;
+            return;
+        }
+    }
+    if (tally.used < 8) {
+        tally.ids[tally.used] = id;
+        tally.counts[tally.used] = 1;
+        tally.used++;
+    }
+}
+
+static uint16_t dominantCondition(const DayTally &tally) {
+    if (tally.used == 0) {
+        return 800;
+    }
+    uint8_t best = 0;
+    for (uint8_t i = 1; i < tally.used; i++) {
+        if (tally.counts[i] > tally.counts[best] ||
+            (tally.counts[i] == tally.counts[best] && conditionSeverity(tally.ids[i]) > conditionSeverity(tally.ids[best]))) {
+            best = i;
+        }
+    }
+    return tally.ids[best];
+}
+
+// Round tenths to whole units
+static int roundTenths(int value) {
+    return (value + (value >= 0 ? 5 : -5)) / 10;
+}
+
+ForecastPage::ForecastPage(Adafruit_ST7789 &display, WeatherHttpSession &session, const WeatherPage &weather, const char *apiKey, const char *city)
+    : tft(display), session(session), weather(weather), apiKey(apiKey), city(city), lastUpdateTime(0), changed(false) {
+    forecast.version = 0;
+    forecast.fetchedAt = 0;
+    forecast.dayCount = 0;
+    path[0] = '\0';
+    cache.clear();
+}
+
+void ForecastPage::setup() {
+    // Everything else in a forecast entry is skipped while parsing
+    filter["dt"] = true;
+    filter["main"]["temp_min"] = true;
+    filter["main"]["temp_max"] = true;
+    filter["weather"][0]["id"] = true;
+    filter["rain"]["3h"] = true;
+    filter["snow"]["3h"] = true;
+
+    snprintf(path, sizeof(path), forecastPathFormat, city, apiKey);
+
+    loadCache();
+
+    // Only fetch at boot if there is no cached forecast; a stale one is shown until it is refreshed
+    if (forecast.dayCount == 0) {
+        refresh();
+        return;
+    }
+
+    time_t now = time(nullptr);
+    if (forecast.fetchedAt > 0 && now > forecast.fetchedAt &&
+        (unsigned long)(now - forecast.fetchedAt) < updateInterval / 1000) {
+        lastUpdateTime = millis() - (now - forecast.fetchedAt) * 1000;
+    } else {
+        lastUpdateTime = millis() - updateInterval;  // Stale or age unknown, due for a refresh
+    }
+}
+
+unsigned long ForecastPage::dataAge() const {
+    return forecast.dayCount > 0 ? millis() - lastUpdateTime : ULONG_MAX;
+}
+
+unsigned long ForecastPage::refreshInterval() const {
+    return updateInterval;
+}
+
+// Called by WeatherRefreshPolicy; drawing is left to update()
+bool ForecastPage::refresh() {
+    if (!getForecast()) {
+        return false;
+    }
+    lastUpdateTime = millis();
+    changed = true;
+    return true;
+}
+
+void ForecastPage::update(bool forceRender) {
+    if (forceRender || changed) {
+        displayForecast();
+        changed = false;
+    }
+}
+
+bool ForecastPage::getForecast() {
+    HttpFetchResult fetch = session.get(path, cache);
+    if (fetch != HttpFetchResult::Ok) {
+        session.end();
+        // Unchanged since the last parse, the forecast we have is current
+        return (fetch == HttpFetchResult::NotModified || fetch == HttpFetchResult::Fresh) && forecast.dayCount > 0;
+    }
+
+    unsigned long parseStart = micros();
+    Stream &stream = session.body();
+    if (!stream.find("\"list\":[")) {
+        Serial.println("Forecast response has no list");
+        session.end();
+        cache.clear();
+        return false;
+    }
+
+    // Reduce the 3-hourly entries one at a time into per-day values
+    Forecast result = {};
+    DayTally tallies[FORECAST_DAYS] = {};
+    int32_t timezoneOffset = weather.getTimezoneOffset();
+    bool ok = true;
+    size_t parseBytes = 0;
+
+    do {
+        // Each entry is parsed on its own, so memory does not grow with the response
+        JsonArena arena(session.arena());
+        JsonDocument entry(&arena);
+        DeserializationError error = deserializeJson(entry, stream, DeserializationOption::Filter(filter));
+        parseBytes = max(parseBytes, arena.peak());
+        if (error) {
+            Serial.print("Failed to parse forecast entry: ");
+            Serial.println(error.c_str());
+            ok = false;
+            break;
+        }
+
+        int32_t day = ((int64_t)(entry["dt"] | 0) + timezoneOffset) / 86400;
+        if (result.dayCount == 0) {
+            result.days[0].day = day;  // First entry is today
+        }
+        int index = day - result.days[0].day;
+        if (index < 0 || index >= FORECAST_DAYS) {
+            continue;  // Partial sixth day
+        }
+
+        ForecastDay &forecastDay = result.days[index];
+        if (index >= result.dayCount) {
+            forecastDay.day = day;
+            forecastDay.minTemp = INT16_MAX;
+            forecastDay.maxTemp = INT16_MIN;
+            forecastDay.precipitation = 0;
+            result.dayCount = index + 1;
+        }
+
+        float minTemp = entry["main"]["temp_min"];
+        float maxTemp = entry["main"]["temp_max"];
+        float precipitation = (entry["rain"]["3h"] | 0.0f) + (entry["snow"]["3h"] | 0.0f);
+        forecastDay.minTemp = min<int16_t>(forecastDay.minTemp, lroundf(minTemp * 10));
+        forecastDay.maxTemp = max<int16_t>(forecastDay.maxTemp, lroundf(maxTemp * 10));
+        forecastDay.precipitation += lroundf(precipitation * 10);
+        tallyCondition(tallies[index], entry["weather"][0]["id"] | 800);
+    } while (stream.findUntil(",", "]"));
+
+    session.end();
+
+    if (!ok || result.dayCount == 0) {
+        cache.clear();  // Don't let a 304 confirm data we never got
+        return false;
+    }
+
+    for (uint8_t i = 0; i < result.dayCount; i++) {
+        result.days[i].conditionId = dominantCondition(tallies[i]);
+    }
+
+    time_t now = time(nullptr);
+    result.version = FORECAST_CACHE_VERSION;
+    result.fetchedAt = now > 1600000000 ? now : 0;
+    forecast = result;
+    saveCache();
+
+    Serial.printf("Forecast: %u days (parsed in %lu us, %u bytes)\n", result.dayCount,
+                  micros() - parseStart, (unsigned)parseBytes);
+    return true;
+}
+
+// Restore the last forecast so the page has something to show right after boot
+void ForecastPage::loadCache() {
+    Preferences prefs;
+    if (!prefs.begin("forecast", true)) {
+        return;
+    }
+
+    Forecast cached;
+    if (prefs.getBytesLength("data") == sizeof(Forecast) &&
+        prefs.getBytes("data", &cached, sizeof(Forecast)) == sizeof(Forecast) &&
+        cached.version == FORECAST_CACHE_VERSION && cached.dayCount <= FORECAST_DAYS) {
+        forecast = cached;
+    }
+    prefs.end();
+}
+
+void ForecastPage::saveCache() {
+    Preferences prefs;
+    if (prefs.begin("forecast", false)) {
+        prefs.putBytes("data", &forecast, sizeof(Forecast));
+        prefs.end();
+    }
+}
+
+void ForecastPage::displayForecast() {
+    static const char *const dayNames[] = {"Thu", "Fri", "Sat", "Sun", "Mon", "Tue", "Wed"};  // 1970-01-01 was a Thursday
+
+    tft.fillScreen(ST77XX_BLACK);  // Clear the screen
+    tft.setTextSize(2);
+
+    if (forecast.dayCount == 0) {
+        tft.setCursor(10, 10);
+        tft.print("No forecast yet");
+        return;
+    }
+
+    // One 48 pixel row per day: icon, weekday, min/max temperature, precipitation
+    char text[16];
+    for (uint8_t i = 0; i < forecast.dayCount; i++) {
+        const ForecastDay &day = forecast.days[i];
+        int16_t rowY = i * 48;
+
+        drawWeatherIcon(tft, 2, rowY + 1, getConditionIcon(day.conditionId, false), 50, 50, 0.9);
+
+        tft.setCursor(56, rowY + 6);
+        tft.print(dayNames[day.day % 7]);
+
+        snprintf(text, sizeof(text), "%d/%d C", roundTenths(day.minTemp), roundTenths(day.maxTemp));
+        tft.setCursor(56, rowY + 26);
+        tft.print(text);
+
+        if (day.precipitation > 0) {
+            snprintf(text, sizeof(text), "%u.%umm", day.precipitation / 10, day.precipitation % 10);
+            tft.setCursor(160, rowY + 16);
+            tft.print(text);
+        }
+    }
+}
@@ -0,0 +1,105 @@
+#include "GasAlarm.h"
+#include "MQTTHandler.h"
+
+GasQuality classifyGasQuality(float mq5Percentage) {
+    if (mq5Percentage < 25) return GasQuality::Excellent;
+    if (mq5Percentage < 35) return GasQuality::Good;
+    if (mq5Percentage < 55) return GasQuality::OK;
+    if (mq5Percentage < GAS_ALARM_THRESHOLD) return GasQuality::Bad;
+    return GasQuality::Danger;
+}
+
+const char *gasQualityName(GasQuality quality) {
+    switch (quality) {
+        case GasQuality::Excellent: return "Excellent";
+        case GasQuality::Good:      return "Good";
+        case GasQuality::OK:        return "OK";
+        case GasQuality::Bad:       return "Bad";
+        case GasQuality::Danger:    return "Danger";
+        default:                    return "Unknown";
+    }
+}
+
+GasAlarm::GasAlarm(int pin)
+    : pin(pin), percentage(0), active(false), overlayDirty(false),
+      overlayShown(false), lastShownLevel(-1) {}
+
+void GasAlarm::begin() {
+    sample();  // Have a reading before the first page renders
+
+    // Same core as loop() but higher priority, so sampling pre-empts whatever the loop is doing
+    xTaskCreatePinnedToCore(taskEntry, "gasAlarm", GAS_ALARM_TASK_STACK, this,
+                            GAS_ALARM_TASK_PRIORITY, nullptr, 1);
+}
+
+float GasAlarm::getPercentage() const {
+    return percentage;
+}
+
+bool GasAlarm::isActive() const {
+    return active;
+}
+
+void GasAlarm::taskEntry(void *param) {
+    GasAlarm *alarm = static_cast<GasAlarm *>(param);
+    TickType_t lastWake = xTaskGetTickCount();
+    while (true) {
+        alarm->sample();
+        vTaskDelayUntil(&lastWake, pdMS_TO_TICKS(GAS_ALARM_SAMPLE_INTERVAL));
+    }
+}
+
+// Read the sensor and check for threshold crossings right away
+void GasAlarm::sample() {
+    float level = (analogRead(pin) / 4095.0) * 100;  // Convert to percentage
+    percentage = level;
+
+    if (!active && level >= GAS_ALARM_THRESHOLD) {
+        active = true;
+        overlayDirty = true;
+        publishGasAlarm(true, level, micros());
+    } else if (active && level < GAS_ALARM_CLEAR_THRESHOLD) {
+        active = false;
+        overlayDirty = true;
+        publishGasAlarm(false, level, micros());
+    }
+}
+
+bool GasAlarm::updateOverlay(Adafruit_ST7789 &tft, bool forceRender) {
+    bool dirty = overlayDirty;
+    overlayDirty = false;
+
+    if (!active) {
+        if (overlayShown) {
+            // Alarm cleared, hand the screen back to the pages
+            overlayShown = false;
+            tft.fillScreen(ST77XX_BLACK);
+        }
+        return false;
+    }
+
+    if (dirty || forceRender || !overlayShown) {
+        tft.fillScreen(ST77XX_RED);
+        tft.setTextColor(ST77XX_WHITE);
+        tft.setTextSize(4);
+        tft.setCursor(40, 50);
+        tft.print("DANGER");
+        tft.setTextSize(2);
+        tft.setCursor(30, 110);
+        tft.print("Gas level high!");
+        overlayShown = true;
+        lastShownLevel = -1;
+    }
+
+    // Keep the level readout current without redrawing the whole overlay
+    int level = (int)percentage;
+    if (level != lastShownLevel) {
+        tft.fillRect(60, 150, 140, 30, ST77XX_RED);
+        tft.setTextSize(3);
+        tft.setCursor(70, 155);
+        tft.print(level);
+        tft.print(" %");
+        lastShownLevel = level;
+    }
+    return true;
+}
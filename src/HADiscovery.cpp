@@ -0,0 +1,54 @@
+#include "HADiscovery.h"
+#include "MQTTHandler.h"
+#include "DeviceIdentity.h"
+
+extern String version;  // Firmware version string
+
+// Per-metric part of the discovery config, kept in flash
+struct DiscoveryTemplate {
+    const char *objectId;
+    const char *fields;
+};
+
+const DiscoveryTemplate discoveryTemplates[] PROGMEM = {
+    {"temperature", "\"name\":\"Temperature\",\"dev_cla\":\"temperature\",\"unit_of_meas\":\"\xC2\xB0" "C\",\"stat_cla\":\"measurement\""},  // Metric::Temperature
+    {"humidity", "\"name\":\"Humidity\",\"dev_cla\":\"humidity\",\"unit_of_meas\":\"%\",\"stat_cla\":\"measurement\""},                    // Metric::Humidity
+    {"mq5_percentage", "\"name\":\"Gas level\",\"unit_of_meas\":\"%\",\"stat_cla\":\"measurement\",\"ic\":\"mdi:gas-cylinder\""},           // Metric::MQ5Percentage
+    {"gas_quality", "\"name\":\"Air quality\",\"ic\":\"mdi:air-filter\""},                                                                 // Metric::GasQuality
+    {"wifi_signal", "\"name\":\"Wi-Fi signal\",\"dev_cla\":\"signal_strength\",\"unit_of_meas\":\"dBm\",\"stat_cla\":\"measurement\",\"ent_cat\":\"diagnostic\""},  // Metric::WiFiSignal
+    {"ip_address", "\"name\":\"IP address\",\"ic\":\"mdi:ip-network\",\"ent_cat\":\"diagnostic\""},                                        // Metric::IpAddress
+    {"mac_address", "\"name\":\"MAC address\",\"ic\":\"mdi:network\",\"ent_cat\":\"diagnostic\""},                                         // Metric::MacAddress
+    {"cpu_freq", "\"name\":\"CPU frequency\",\"dev_cla\":\"frequency\",\"unit_of_meas\":\"MHz\",\"ent_cat\":\"diagnostic\""},              // Metric::CpuFreq
+    {"free_mem", "\"name\":\"Free memory\",\"ic\":\"mdi:memory\",\"ent_cat\":\"diagnostic\""},                                             // Metric::FreeMem
+    {"max_alloc", "\"name\":\"Largest free block\",\"dev_cla\":\"data_size\",\"unit_of_meas\":\"B\",\"ent_cat\":\"diagnostic\""},           // Metric::HeapMaxAlloc
+    {"min_free", "\"name\":\"Minimum free memory\",\"dev_cla\":\"data_size\",\"unit_of_meas\":\"B\",\"ent_cat\":\"diagnostic\""},          // Metric::HeapMinFree
+    {"allocations", "\"name\":\"Heap allocations\",\"ic\":\"mdi:memory\",\"stat_cla\":\"total_increasing\",\"val_tpl\":\"{{ value_json.total }}\",\"ent_cat\":\"diagnostic\""}  // Metric::HeapAllocations
+};
+
+// Parts shared by all metrics: state and availability topics, unique ID and device block
+const char discoveryFormat[] PROGMEM =
+    "{%s,\"stat_t\":\"%s\",\"avty_t\":\"%s\",\"uniq_id\":\"%s_%s\","
+    "\"dev\":{\"ids\":[\"%s\"],\"name\":\"Weather Station %s\",\"mdl\":\"ESP32 MQTT Weather Station\",\"sw\":\"%s\"}}";
+
+void publishHomeAssistantDiscovery(MQTTSession &client) {
+    char topic[MQTT_MAX_TOPIC_LENGTH];
+    const char *clientId = getMqttClientId();
+
+    MemArena &arena = getMqttArena();
+    size_t mark = arena.mark();
+    char *payload = static_cast<char *>(arena.allocate(HA_DISCOVERY_PAYLOAD_SIZE));
+    if (payload == nullptr) {
+        return;
+    }
+
+    for (size_t i = 0; i < static_cast<size_t>(Metric::Count); i++) {
+        const DiscoveryTemplate &entry = discoveryTemplates[i];
+
+        snprintf(topic, sizeof(topic), HA_DISCOVERY_PREFIX "/sensor/%s/%s/config", clientId, entry.objectId);
+        snprintf(payload, HA_DISCOVERY_PAYLOAD_SIZE, discoveryFormat, entry.fields, getMetricTopic(static_cast<Metric>(i)),
+                 getAvailabilityTopic(), clientId, entry.objectId, clientId, getDeviceId(), version.c_str());
+
+        client.publish(topic, payload, true);  // Retained so Home Assistant picks it up after a restart
+    }
+    arena.rewind(mark);
+}
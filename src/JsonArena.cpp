@@ -0,0 +1,35 @@
+#include "JsonArena.h"
+
+JsonArena::JsonArena(MemArena &arena) : arena(arena), start(arena.mark()), highWater(0) {}
+
+JsonArena::~JsonArena() {
+    arena.rewind(start);
+}
+
+void *JsonArena::allocate(size_t size) {
+    void *ptr = arena.allocate(size);  // nullptr makes ArduinoJson report NoMemory
+    highWater = max(highWater, used());
+    return ptr;
+}
+
+void JsonArena::deallocate(void *ptr) {
+    arena.deallocate(ptr);
+}
+
+void *JsonArena::reallocate(void *ptr, size_t newSize) {
+    void *moved = arena.reallocate(ptr, newSize);
+    highWater = max(highWater, used());
+    return moved;
+}
+
+void JsonArena::reset() {
+    arena.rewind(start);
+}
+
+size_t JsonArena::used() const {
+    return arena.used() > start ? arena.used() - start : 0;
+}
+
+size_t JsonArena::peak() const {
+    return highWater;
+}
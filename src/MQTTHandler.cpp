@@ -1,112 +1,497 @@
 #include "MQTTHandler.h"
+#include "OfflineQueue.h"
+#include "MQTTSession.h"
+#include "DeviceIdentity.h"
+#include "HADiscovery.h"
+#include "WeatherShare.h"
+#include "MemStats.h"
 #include <WiFi.h>
-#include <PubSubClient.h>
+#include <time.h>
 
 // MQTT Broker settings
 const char* mqttServer = "192.168.178.82";
 const int mqttPort = 1883;
 
+// Reconnect and backfill pacing
+const unsigned long MQTT_RECONNECT_INTERVAL = 5000;  // Time between reconnect attempts
+const uint32_t MQTT_TCP_CONNECT_TIMEOUT = 1000;      // The broker is on the LAN, don't stall the loop for longer
+const unsigned long BACKFILL_INTERVAL = 200;         // Time between backfill bursts
+const int BACKFILL_BURST = 5;                        // Queued samples published per burst
+const unsigned long MEMORY_PUBLISH_INTERVAL = 60000; // Time between heap statistics
+const unsigned long BACKFILL_NTP_WAIT = 60000;       // How long uptime-stamped samples wait for NTP
+
+// Sensor values are published with acknowledged delivery into a persistent session
+const uint8_t SENSOR_QOS = 1;
+const bool CLEAN_SESSION = false;
+
 WiFiClient espClient;
-PubSubClient client(espClient);
+MQTTSession client(espClient);
+
+// Topic suffixes for each metric, indexed by Metric. Only time series are kept while the broker is unreachable.
+struct MetricTopic {
+    const char* suffix;
+    bool queueWhenOffline;
+};
+
+const MetricTopic metricTopics[] = {
+    {"dht/temperature", true},  // Metric::Temperature
+    {"dht/humidity", true},     // Metric::Humidity
+    {"mq5/percentage", true},   // Metric::MQ5Percentage
+    {"mq5/gas", true},          // Metric::GasQuality
+    {"wifi/signal", true},      // Metric::WiFiSignal
+    {"wifi/ip", false},         // Metric::IpAddress
+    {"wifi/mac", false},        // Metric::MacAddress
+    {"esp32/cpu_freq", false},  // Metric::CpuFreq
+    {"esp32/free_mem", true},   // Metric::FreeMem
+    {"esp32/max_alloc", true},  // Metric::HeapMaxAlloc
+    {"esp32/min_free", true},   // Metric::HeapMinFree
+    {"esp32/allocations", false}  // Metric::HeapAllocations
+};
+
+alignas(max_align_t) uint8_t mqttArenaBuffer[MQTT_ARENA_SIZE];
+MemArena mqttArena("mqtt", mqttArenaBuffer, sizeof(mqttArenaBuffer));
+
+// Full topics, formatted once in setupMQTT so publishing never builds strings
+const size_t METRIC_COUNT = static_cast<size_t>(Metric::Count);
+char liveTopics[METRIC_COUNT][MQTT_MAX_TOPIC_LENGTH];
+char backfillTopics[METRIC_COUNT][MQTT_MAX_TOPIC_LENGTH];
+char availabilityTopic[MQTT_MAX_TOPIC_LENGTH];
+char alarmTopic[MQTT_MAX_TOPIC_LENGTH];
+
+// The session is shared between the loop task and the gas alarm task
+SemaphoreHandle_t mqttMutex = nullptr;
+const TickType_t ALARM_LOCK_TIMEOUT = pdMS_TO_TICKS(50);
+
+// Alarm state that could not be published yet, sent right after the next reconnect.
+// The gas task writes it without holding mqttMutex, so it has its own spinlock.
+struct PendingAlarm {
+    bool pending;
+    bool danger;
+    float level;
+    uint32_t detectedAt;  // micros() of the original detection, keeps latency_us honest
+    uint32_t sequence;    // Bumped on every change so a re-publish can't clear a newer state
+};
+PendingAlarm pendingAlarm = {};
+portMUX_TYPE pendingAlarmMux = portMUX_INITIALIZER_UNLOCKED;
+
+// Set on connect and when Home Assistant comes online, cleared once discovery has been sent
+bool discoveryPending = false;
+
+// Samples taken while the broker was unreachable
+OfflineQueue offlineQueue("/mqtt_queue.bin");
+unsigned long lastReconnectAttempt = 0;
+unsigned long lastBackfillTime = 0;
+unsigned long ntpWaitStartedAt = 0;
+bool waitingForNtp = false;
+
+// Counters for getMQTTStats
+uint32_t mqttConnects = 0;
+uint32_t mqttPublished = 0;
+uint32_t mqttDowngraded = 0;  // Sensor values sent at QoS 0 because QoS 1 was refused
 
 // Previous sensor values for comparison
 float lastDHTTemp = -100.0;
 float lastDHTHumidity = -100.0;
 float lastMQ5Percentage = -100.0;
-String lastGasQuality = "Unknown";
+GasQuality lastGasQuality = GasQuality::Unknown;
 int lastWiFiSignalStrength = 0;
-String lastIPAddress = "";
-String lastMACAddress = "";
+char lastIPAddress[16] = "";
+char lastMACAddress[18] = "";
 int lastCPUFreq = 0;
-String lastFreeMem = "";
+uint32_t lastFreeHeap = 0;
+unsigned long lastMemoryPublish = 0;
+bool memoryPublished = false;
+
+// Forget the previously published values so the next cycle refreshes every retained topic
+void resetLastPublishedValues() {
+    lastDHTTemp = -100.0;
+    lastDHTHumidity = -100.0;
+    lastMQ5Percentage = -100.0;
+    lastGasQuality = GasQuality::Unknown;
+    lastWiFiSignalStrength = 0;
+    lastIPAddress[0] = '\0';
+    lastMACAddress[0] = '\0';
+    lastCPUFreq = 0;
+    lastFreeHeap = 0;
+    memoryPublished = false;
+}
+
+// Start a connection attempt or check on the one in progress, returns true when connected
+bool connectMQTT(const char* user, const char* password) {
+    bool started = !client.connecting();
+    if (started) {
+        Serial.print("Connecting to MQTT...");
+    }
+    if (client.connect(getMqttClientId(), user, password, CLEAN_SESSION)) {
+        Serial.println(client.sessionPresent() ? "connected (session resumed)" : "connected");
+        mqttConnects++;
+        client.publish(availabilityTopic, "online", true);
+        client.subscribe(HA_STATUS_TOPIC);
+        if (WEATHER_SHARE) {
+            client.subscribe(getWeatherShareTopic());
+        }
+        discoveryPending = true;
+        resetLastPublishedValues();  // Retained values may have changed while we were away
+        return true;
+    }
+
+    if (!client.connecting()) {
+        Serial.print("failed with state ");
+        Serial.println(client.state());
+    }
+    return false;
+}
+
+// Handle messages on subscribed topics
+void onMQTTMessage(const char* topic, const uint8_t* payload, size_t length) {
+    // Home Assistant birth message: it may have lost its entities, announce them again
+    if (strcmp(topic, HA_STATUS_TOPIC) == 0 && length == 6 && memcmp(payload, "online", 6) == 0) {
+        discoveryPending = true;
+    }
+
+    // Weather fetched by another station
+    if (WEATHER_SHARE && strcmp(topic, getWeatherShareTopic()) == 0) {
+        handleWeatherShareMessage(payload, length);
+    }
+}
 
 // Function to connect to the MQTT broker
 void setupMQTT(const char* user, const char* password) {
+    for (size_t i = 0; i < METRIC_COUNT; i++) {
+        snprintf(liveTopics[i], sizeof(liveTopics[i]), "%s/%s", getTopicPrefix(), metricTopics[i].suffix);
+        snprintf(backfillTopics[i], sizeof(backfillTopics[i]), "%s/backfill", liveTopics[i]);
+    }
+    snprintf(availabilityTopic, sizeof(availabilityTopic), "%s/status", getTopicPrefix());
+    snprintf(alarmTopic, sizeof(alarmTopic), "%s/mq5/alarm", getTopicPrefix());
+    mqttMutex = xSemaphoreCreateMutex();
+
+    espClient.setConnectionTimeout(MQTT_TCP_CONNECT_TIMEOUT);
     client.setServer(mqttServer, mqttPort);
+    client.setWill(availabilityTopic, "offline", true);
+    client.setCallback(onMQTTMessage);
+    offlineQueue.begin();
 
-    while (!client.connected()) {
-        Serial.print("Connecting to MQTT...");
-        if (client.connect("WeatherStationClient", user, password)) {
-            Serial.println("connected");
+    // Try once; maintainMQTTConnection keeps retrying without blocking the loop
+    connectMQTT(user, password);
+    lastReconnectAttempt = millis();
+}
+
+// Seconds since epoch if the clock has been set via NTP, 0 otherwise
+uint32_t currentEpoch() {
+    time_t now = time(nullptr);
+    return now > 1600000000 ? (uint32_t)now : 0;
+}
+
+// Publish a few queued samples to "<topic>/backfill" with their original timestamps
+void drainOfflineQueue() {
+    if (offlineQueue.empty()) {
+        waitingForNtp = false;  // The next outage gets its own wait
+        return;
+    }
+    if (millis() - lastBackfillTime < BACKFILL_INTERVAL) {
+        return;
+    }
+    lastBackfillTime = millis();
+
+    uint32_t epoch = currentEpoch();
+    if (epoch != 0) {
+        waitingForNtp = false;
+    }
+    uint32_t uptime = millis() / 1000;
+    QueuedSample sample;
+    for (int i = 0; i < BACKFILL_BURST && client.canPublish() && offlineQueue.peek(sample); i++) {
+        uint32_t timestamp = sample.timestamp;
+        if (sample.flags & SAMPLE_FLAG_UPTIME) {
+            if (epoch != 0 && sample.timestamp <= uptime) {
+                timestamp = epoch - (uptime - sample.timestamp);
+            } else if (epoch == 0 && (!waitingForNtp || millis() - ntpWaitStartedAt < BACKFILL_NTP_WAIT)) {
+                // Wait a while for NTP so the sample can be placed on the timeline
+                if (!waitingForNtp) {
+                    waitingForNtp = true;
+                    ntpWaitStartedAt = millis();
+                }
+                return;
+            } else {
+                timestamp = 0;  // Never synced (or uptime wrapped), sent without a timestamp
+            }
+        }
+
+        char payload[48];
+        if (timestamp != 0) {
+            snprintf(payload, sizeof(payload), "{\"v\":\"%s\",\"ts\":%u}", sample.value, (unsigned)timestamp);
         } else {
-            Serial.print("failed with state ");
-            Serial.println(client.state());
-            delay(2000);
+            snprintf(payload, sizeof(payload), "{\"v\":\"%s\"}", sample.value);
         }
+
+        if (!client.publish(backfillTopics[sample.metric], payload, false, SENSOR_QOS)) {
+            return;  // Try again on the next burst
+        }
+        offlineQueue.pop();
+    }
+}
+
+// Publish the alarm state, caller holds mqttMutex
+static void setPendingAlarm(bool danger, float level, uint32_t detectedAt) {
+    portENTER_CRITICAL(&pendingAlarmMux);
+    pendingAlarm.pending = true;
+    pendingAlarm.danger = danger;
+    pendingAlarm.level = level;
+    pendingAlarm.detectedAt = detectedAt;
+    pendingAlarm.sequence++;
+    portEXIT_CRITICAL(&pendingAlarmMux);
+}
+
+// Caller holds mqttMutex
+static bool publishAlarmLocked(bool danger, float level, uint32_t detectedAt) {
+    char payload[64];
+    snprintf(payload, sizeof(payload), "{\"state\":\"%s\",\"level\":%.1f,\"latency_us\":%u}",
+             danger ? "danger" : "clear", level, (unsigned)(micros() - detectedAt));
+    return client.publish(alarmTopic, payload, true, SENSOR_QOS);
+}
+
+// Re-publish the alarm state the gas task couldn't send, caller holds mqttMutex
+static void publishPendingAlarmLocked() {
+    portENTER_CRITICAL(&pendingAlarmMux);
+    PendingAlarm alarm = pendingAlarm;
+    portEXIT_CRITICAL(&pendingAlarmMux);
+
+    if (!alarm.pending || !publishAlarmLocked(alarm.danger, alarm.level, alarm.detectedAt)) {
+        return;
+    }
+
+    portENTER_CRITICAL(&pendingAlarmMux);
+    if (pendingAlarm.sequence == alarm.sequence) {
+        pendingAlarm.pending = false;
+    }
+    portEXIT_CRITICAL(&pendingAlarmMux);
+}
+
+// Publish a gas alarm state change immediately, bypassing the deadband and the offline queue
+bool publishGasAlarm(bool danger, float level, uint32_t detectedAt) {
+    if (mqttMutex == nullptr) {
+        return false;
+    }
+
+    if (xSemaphoreTake(mqttMutex, ALARM_LOCK_TIMEOUT) != pdTRUE) {
+        // The loop is busy (re)connecting, publish as soon as it is done
+        setPendingAlarm(danger, level, detectedAt);
+        return false;
     }
+
+    bool published = publishAlarmLocked(danger, level, detectedAt);
+    if (published) {
+        // This is the newest state, anything still pending is stale
+        portENTER_CRITICAL(&pendingAlarmMux);
+        pendingAlarm.pending = false;
+        portEXIT_CRITICAL(&pendingAlarmMux);
+    } else {
+        setPendingAlarm(danger, level, detectedAt);
+    }
+    xSemaphoreGive(mqttMutex);
+    return published;
+}
+
+// Publish a shared weather snapshot, retained so stations that start later get it right away
+bool publishSharedWeather(const char* topic, const char* payload) {
+    xSemaphoreTake(mqttMutex, portMAX_DELAY);
+    bool published = client.connected() && client.publish(topic, payload, true);
+    xSemaphoreGive(mqttMutex);
+    return published;
 }
 
 // Function to maintain MQTT connection
 void maintainMQTTConnection(const char* user, const char* password) {
+    MemScope memScope(MemSubsystem::MQTT);
+    xSemaphoreTake(mqttMutex, portMAX_DELAY);
+
     if (!client.connected()) {
-        setupMQTT(user, password);  // Reconnect if disconnected
+        if (client.connecting()) {
+            connectMQTT(user, password);  // Waiting for the broker's answer
+        } else if (millis() - lastReconnectAttempt >= MQTT_RECONNECT_INTERVAL) {
+            lastReconnectAttempt = millis();
+            connectMQTT(user, password);  // Reconnect if disconnected
+        }
+        xSemaphoreGive(mqttMutex);
+        return;
     }
     client.loop();  // Regularly call this to process MQTT messages
+
+    publishPendingAlarmLocked();
+
+    if (discoveryPending) {
+        publishHomeAssistantDiscovery(client);
+        discoveryPending = false;
+    }
+
+    drainOfflineQueue();
+    xSemaphoreGive(mqttMutex);
 }
 
-// Function to publish single sensor data to MQTT
-void publishSingleSensorData(const char* topic, const String& value) {
-    if (client.connected()) {
-        client.publish(topic, value.c_str(), true);  // Retain the message
+MQTTStats getMQTTStats() {
+    MQTTStats stats = {};
+    if (mqttMutex == nullptr) {
+        return stats;
+    }
+
+    xSemaphoreTake(mqttMutex, portMAX_DELAY);
+    stats.connected = client.connected();
+    stats.connects = mqttConnects;
+    stats.published = mqttPublished;
+    stats.downgraded = mqttDowngraded;
+    stats.acknowledged = client.acknowledgedCount();
+    stats.retransmits = client.retransmitCount();
+    stats.queued = offlineQueue.size();
+    stats.dropped = offlineQueue.droppedCount();
+    xSemaphoreGive(mqttMutex);
+    return stats;
+}
+
+const char* getMetricTopic(Metric metric) {
+    return liveTopics[static_cast<uint8_t>(metric)];
+}
+
+MemArena& getMqttArena() {
+    return mqttArena;
+}
+
+const char* getAvailabilityTopic() {
+    return availabilityTopic;
+}
+
+// Function to publish single sensor data to MQTT, queueing it while the broker is unreachable.
+// Caller holds mqttMutex.
+void publishSingleSensorData(Metric metric, const char* value) {
+    const char* topic = liveTopics[static_cast<uint8_t>(metric)];
+
+    if (client.publish(topic, value, true, SENSOR_QOS)) {  // Retain the message
+        mqttPublished++;
+        return;
+    }
+
+    // In-flight window saturated: fall back to QoS 0 rather than let the live value lag, and count it
+    if (client.connected() && client.publish(topic, value, true, 0)) {
+        mqttPublished++;
+        mqttDowngraded++;
+        return;
+    }
+
+    if (metricTopics[static_cast<uint8_t>(metric)].queueWhenOffline) {
+        QueuedSample sample;
+        sample.metric = static_cast<uint8_t>(metric);
+        sample.timestamp = currentEpoch();
+        sample.flags = 0;
+        if (sample.timestamp == 0) {
+            sample.timestamp = millis() / 1000;
+            sample.flags = SAMPLE_FLAG_UPTIME;
+        }
+        strlcpy(sample.value, value, sizeof(sample.value));
+        offlineQueue.push(sample);
+    }
+}
+
+// Publish a number, formatted the way String(value) did
+void publishSingleSensorData(Metric metric, float value) {
+    char payload[16];
+    snprintf(payload, sizeof(payload), "%.2f", value);
+    publishSingleSensorData(metric, payload);
+}
+
+void publishSingleSensorData(Metric metric, int value) {
+    char payload[12];
+    snprintf(payload, sizeof(payload), "%d", value);
+    publishSingleSensorData(metric, payload);
+}
+
+// Heap health for long-term monitoring, on a timer rather than a deadband. Caller holds mqttMutex.
+void publishMemoryStats() {
+    if (memoryPublished && millis() - lastMemoryPublish < MEMORY_PUBLISH_INTERVAL) {
+        return;
+    }
+    memoryPublished = true;
+    lastMemoryPublish = millis();
+
+    MemSnapshot memory;
+    readMemSnapshot(memory);
+    publishSingleSensorData(Metric::HeapMaxAlloc, (int)memory.largestBlock);
+    publishSingleSensorData(Metric::HeapMinFree, (int)memory.minFreeHeap);
+
+    // {"total":1234,"frag":12,"other":..,"weather":..,"mqtt":..,"web":..,"display":..}
+    char payload[192];
+    int length = snprintf(payload, sizeof(payload), "{\"total\":%u,\"frag\":%u",
+                          (unsigned)allocationCount(), (unsigned)memory.fragmentation);
+    for (size_t i = 0; i < static_cast<size_t>(MemSubsystem::Count) && length < (int)sizeof(payload); i++) {
+        length += snprintf(payload + length, sizeof(payload) - length, ",\"%s\":%u",
+                           memSubsystemName(static_cast<MemSubsystem>(i)), (unsigned)memory.allocations[i]);
+    }
+    if (length < (int)sizeof(payload) - 1) {
+        strcat(payload, "}");
+        publishSingleSensorData(Metric::HeapAllocations, payload);
     }
 }
 
 // Function to process sensor data, compare with previous values, and publish only changed ones
-void processAndPublishSensorData(float dhtTemp, float dhtHumidity, float mq5Percentage, const String& gasQuality, 
-                                int wifiSignalStrength, const String& ipAddress, const String& macAddress, 
-                                int cpuFreq, const String& freeMem) {
+void processAndPublishSensorData(float dhtTemp, float dhtHumidity, float mq5Percentage, GasQuality gasQuality,
+                                int wifiSignalStrength, const char* ipAddress, const char* macAddress,
+                                int cpuFreq, uint32_t freeHeap) {
+    MemScope memScope(MemSubsystem::MQTT);
+    xSemaphoreTake(mqttMutex, portMAX_DELAY);
 
     // Temperature
     if (abs(dhtTemp - lastDHTTemp) > 0.1) {
-        publishSingleSensorData("home/dht/temperature", String(dhtTemp));
+        publishSingleSensorData(Metric::Temperature, dhtTemp);
         lastDHTTemp = dhtTemp;
     }
 
     // Humidity
     if (abs(dhtHumidity - lastDHTHumidity) > 1.0) {
-        publishSingleSensorData("home/dht/humidity", String(dhtHumidity));
+        publishSingleSensorData(Metric::Humidity, dhtHumidity);
         lastDHTHumidity = dhtHumidity;
     }
 
     // MQ5 Gas Percentage
-    if (abs(mq5Percentage - lastMQ5Percentage) > 2.5) { 
-        publishSingleSensorData("home/mq5/percentage", String(mq5Percentage));
+    if (abs(mq5Percentage - lastMQ5Percentage) > 2.5) {
+        publishSingleSensorData(Metric::MQ5Percentage, mq5Percentage);
         lastMQ5Percentage = mq5Percentage;
     }
 
     // Gas quality
     if (gasQuality != lastGasQuality) {
-        publishSingleSensorData("home/mq5/gas", gasQuality);
+        publishSingleSensorData(Metric::GasQuality, gasQualityName(gasQuality));
         lastGasQuality = gasQuality;
     }
 
     // Wi-Fi Signal Strength
     if (abs(wifiSignalStrength - lastWiFiSignalStrength) > 3) {
-        publishSingleSensorData("home/wifi/signal", String(wifiSignalStrength));
+        publishSingleSensorData(Metric::WiFiSignal, wifiSignalStrength);
         lastWiFiSignalStrength = wifiSignalStrength;
     }
 
     // IP Address
-    if (ipAddress != lastIPAddress) {
-        publishSingleSensorData("home/wifi/ip", ipAddress);
-        lastIPAddress = ipAddress;
+    if (strcmp(ipAddress, lastIPAddress) != 0) {
+        publishSingleSensorData(Metric::IpAddress, ipAddress);
+        strlcpy(lastIPAddress, ipAddress, sizeof(lastIPAddress));
     }
 
     // MAC Address
-    if (macAddress != lastMACAddress) {
-        publishSingleSensorData("home/wifi/mac", macAddress);
-        lastMACAddress = macAddress;
+    if (strcmp(macAddress, lastMACAddress) != 0) {
+        publishSingleSensorData(Metric::MacAddress, macAddress);
+        strlcpy(lastMACAddress, macAddress, sizeof(lastMACAddress));
     }
 
     // CPU Frequency
     if (cpuFreq != lastCPUFreq) {
-        publishSingleSensorData("home/esp32/cpu_freq", String(cpuFreq));
+        publishSingleSensorData(Metric::CpuFreq, cpuFreq);
         lastCPUFreq = cpuFreq;
     }
 
     // Free Memory
-    if (abs(freeMem.toInt() - lastFreeMem.toInt()) >= 5120) { // 5KB = 5120 bytes
-        publishSingleSensorData("home/esp32/free_mem", freeMem);
-        lastFreeMem = freeMem;
+    if (abs((int32_t)(freeHeap - lastFreeHeap)) >= 5120) { // 5KB = 5120 bytes
+        char freeMem[16];
+        formatMemory(freeHeap, freeMem, sizeof(freeMem));
+        publishSingleSensorData(Metric::FreeMem, freeMem);
+        lastFreeHeap = freeHeap;
     }
+
+    publishMemoryStats();
+    xSemaphoreGive(mqttMutex);
 }
@@ -0,0 +1,456 @@
+#include "MQTTSession.h"
+
+// MQTT control packet types (upper nibble of the fixed header)
+#define MQTT_CONNECT     0x10
+#define MQTT_CONNACK     0x20
+#define MQTT_PUBLISH     0x30
+#define MQTT_PUBACK      0x40
+#define MQTT_SUBSCRIBE   0x80
+#define MQTT_SUBACK      0x90
+#define MQTT_PINGREQ     0xC0
+#define MQTT_PINGRESP    0xD0
+#define MQTT_DISCONNECT  0xE0
+
+// Parser stages for incoming packets
+#define RX_STAGE_HEADER  0
+#define RX_STAGE_LENGTH  1
+#define RX_STAGE_BODY    2
+
+MQTTSession::MQTTSession(Client &client)
+    : client(client), host(nullptr), port(1883), callback(nullptr),
+      willTopic(nullptr), willPayload(nullptr), willRetain(false),
+      currentState(MQTT_STATE_DISCONNECTED), sessionWasPresent(false), nextPacketId(1),
+      lastOutbound(0), lastInbound(0), pingOutstanding(false), awaitingConnack(false), connectStartedAt(0),
+      inflightUsed(0), acknowledged(0), retransmits(0), oversized(0), rxType(0), rxLength(0), rxReceived(0),
+      rxLengthShift(0), rxStage(RX_STAGE_HEADER) {
+    for (auto &message : inflight) {
+        message.used = false;
+    }
+}
+
+void MQTTSession::setServer(const char *host, uint16_t port) {
+    this->host = host;
+    this->port = port;
+}
+
+void MQTTSession::setCallback(MQTTMessageCallback callback) {
+    this->callback = callback;
+}
+
+void MQTTSession::setWill(const char *topic, const char *payload, bool retain) {
+    willTopic = topic;
+    willPayload = payload;
+    willRetain = retain;
+}
+
+// Append a length-prefixed UTF-8 string, returns the new write position
+static size_t writeString(uint8_t *buffer, size_t pos, const char *value) {
+    size_t length = strlen(value);
+    buffer[pos++] = length >> 8;
+    buffer[pos++] = length & 0xFF;
+    memcpy(buffer + pos, value, length);
+    return pos + length;
+}
+
+bool MQTTSession::connect(const char *clientId, const char *user, const char *password, bool cleanSession) {
+    if (awaitingConnack) {
+        return finishConnect();
+    }
+    if (!client.connect(host, port)) {
+        currentState = MQTT_STATE_CONNECT_FAILED;
+        return false;
+    }
+
+    // Variable header: protocol name, level 4 (3.1.1), connect flags, keep alive
+    uint8_t flags = (cleanSession ? 0x02 : 0x00) | (user ? 0x80 : 0x00) | (password ? 0x40 : 0x00);
+    if (willTopic) {
+        flags |= 0x04 | (willRetain ? 0x20 : 0x00);  // Will at QoS 0
+    }
+    const uint8_t variable[] = {0x00, 0x04, 'M', 'Q', 'T', 'T', 0x04, flags, 0x00, MQTT_KEEPALIVE_SECONDS};
+
+    // Payload: client ID, will topic and message, user name, password
+    uint8_t payload[256];
+    size_t required = strlen(clientId) + (user ? strlen(user) : 0) + (password ? strlen(password) : 0) + 10;
+    if (willTopic) {
+        required += strlen(willTopic) + strlen(willPayload);
+    }
+    if (required > sizeof(payload)) {
+        client.stop();
+        currentState = MQTT_STATE_CONNECT_FAILED;
+        return false;
+    }
+    size_t length = writeString(payload, 0, clientId);
+    if (willTopic) {
+        length = writeString(payload, length, willTopic);
+        length = writeString(payload, length, willPayload);
+    }
+    if (user) length = writeString(payload, length, user);
+    if (password) length = writeString(payload, length, password);
+
+    if (!sendPacket(MQTT_CONNECT, variable, sizeof(variable), payload, length)) {
+        markDisconnected(MQTT_STATE_CONNECT_FAILED);
+        return false;
+    }
+
+    awaitingConnack = true;
+    connectStartedAt = millis();
+    return finishConnect();
+}
+
+// Check for the CONNACK without blocking: type, length, acknowledge flags, return code
+bool MQTTSession::finishConnect() {
+    if (client.available() < 4) {
+        if (millis() - connectStartedAt >= MQTT_CONNECT_TIMEOUT) {
+            markDisconnected(MQTT_STATE_CONNECTION_TIMEOUT);
+        }
+        return false;
+    }
+    awaitingConnack = false;
+
+    uint8_t connack[4];
+    client.read(connack, sizeof(connack));
+    if (connack[0] != MQTT_CONNACK || connack[3] != 0) {
+        markDisconnected(connack[0] == MQTT_CONNACK ? connack[3] : MQTT_STATE_CONNECT_FAILED);
+        return false;
+    }
+
+    currentState = MQTT_STATE_CONNECTED;
+    sessionWasPresent = connack[2] & 0x01;
+    lastInbound = millis();
+    pingOutstanding = false;
+    rxStage = RX_STAGE_HEADER;
+
+    // Anything still unacknowledged from before the disconnect is resent into the session
+    retransmitExpired(true);
+    return true;
+}
+
+void MQTTSession::disconnect() {
+    if (currentState == MQTT_STATE_CONNECTED) {
+        sendSimple(MQTT_DISCONNECT, 0);
+    }
+    markDisconnected(MQTT_STATE_DISCONNECTED);
+}
+
+bool MQTTSession::connected() {
+    if (currentState == MQTT_STATE_CONNECTED && !client.connected()) {
+        markDisconnected(MQTT_STATE_CONNECTION_LOST);
+    }
+    return currentState == MQTT_STATE_CONNECTED;
+}
+
+bool MQTTSession::connecting() const {
+    return awaitingConnack;
+}
+
+int MQTTSession::state() const {
+    return currentState;
+}
+
+bool MQTTSession::sessionPresent() const {
+    return sessionWasPresent;
+}
+
+bool MQTTSession::publish(const char *topic, const char *payload, bool retain, uint8_t qos) {
+    if (!connected()) {
+        return false;
+    }
+
+    size_t payloadLength = strlen(payload);
+    if (qos == 0) {
+        return sendPublish(topic, reinterpret_cast<const uint8_t *>(payload), payloadLength, retain, 0, false, 0);
+    }
+
+    // Not silently downgraded: the caller decides what to do with it
+    if (strlen(topic) >= MQTT_MAX_TOPIC_LENGTH || payloadLength > MQTT_MAX_INFLIGHT_PAYLOAD) {
+        Serial.printf("MQTT: %u byte message on %s too large for QoS 1\n", (unsigned)payloadLength, topic);
+        oversized++;
+        return false;
+    }
+
+    if (!canPublish()) {
+        return false;  // Window full, caller keeps the message
+    }
+
+    InflightMessage *slot = nullptr;
+    for (auto &message : inflight) {
+        if (!message.used) {
+            slot = &message;
+            break;
+        }
+    }
+
+    slot->used = true;
+    slot->retain = retain;
+    slot->packetId = allocatePacketId();
+    slot->attempts = 1;
+    slot->sentAt = millis();
+    slot->payloadLength = payloadLength;
+    strlcpy(slot->topic, topic, sizeof(slot->topic));
+    memcpy(slot->payload, payload, payloadLength);
+    inflightUsed++;
+
+    // A failed write is recovered by the retransmit timer or the next reconnect
+    sendPublish(slot->topic, reinterpret_cast<const uint8_t *>(slot->payload), slot->payloadLength,
+                retain, 1, false, slot->packetId);
+    return true;
+}
+
+bool MQTTSession::subscribe(const char *topic) {
+    if (!connected() || strlen(topic) >= MQTT_MAX_TOPIC_LENGTH) {
+        return false;
+    }
+
+    uint16_t packetId = allocatePacketId();
+    const uint8_t variable[] = {(uint8_t)(packetId >> 8), (uint8_t)(packetId & 0xFF)};
+
+    uint8_t payload[MQTT_MAX_TOPIC_LENGTH + 3];
+    size_t length = writeString(payload, 0, topic);
+    payload[length++] = 0;  // Requested QoS 0
+
+    return sendPacket(MQTT_SUBSCRIBE | 0x02, variable, sizeof(variable), payload, length);
+}
+
+bool MQTTSession::canPublish() const {
+    return currentState == MQTT_STATE_CONNECTED && inflightUsed < MQTT_INFLIGHT_WINDOW;
+}
+
+void MQTTSession::loop() {
+    if (!connected()) {
+        return;
+    }
+
+    readPackets();
+    if (currentState != MQTT_STATE_CONNECTED) {
+        return;
+    }
+
+    // Keep alive handling, same policy as PubSubClient
+    unsigned long now = millis();
+    const unsigned long keepAlive = MQTT_KEEPALIVE_SECONDS * 1000UL;
+    if (now - lastOutbound > keepAlive || now - lastInbound > keepAlive) {
+        if (pingOutstanding) {
+            markDisconnected(MQTT_STATE_CONNECTION_TIMEOUT);
+            return;
+        }
+        sendSimple(MQTT_PINGREQ, 0);
+        pingOutstanding = true;
+        lastInbound = now;
+    }
+
+    retransmitExpired(false);
+}
+
+uint8_t MQTTSession::inflightCount() const {
+    return inflightUsed;
+}
+
+uint32_t MQTTSession::acknowledgedCount() const {
+    return acknowledged;
+}
+
+uint32_t MQTTSession::retransmitCount() const {
+    return retransmits;
+}
+
+uint32_t MQTTSession::oversizedCount() const {
+    return oversized;
+}
+
+uint16_t MQTTSession::allocatePacketId() {
+    while (true) {
+        uint16_t id = nextPacketId++;
+        if (nextPacketId == 0) {
+            nextPacketId = 1;  // 0 is not a valid packet ID
+        }
+
+        bool inUse = false;
+        for (const auto &message : inflight) {
+            if (message.used && message.packetId == id) {
+                inUse = true;
+                break;
+            }
+        }
+        if (!inUse) {
+            return id;
+        }
+    }
+}
+
+bool MQTTSession::sendPublish(const char *topic, const uint8_t *payload, size_t length, bool retain,
+                              uint8_t qos, bool dup, uint16_t packetId) {
+    size_t topicLength = strlen(topic);
+    if (topicLength >= MQTT_MAX_TOPIC_LENGTH) {
+        return false;
+    }
+
+    uint8_t variable[MQTT_MAX_TOPIC_LENGTH + 4];
+    size_t variableLength = writeString(variable, 0, topic);
+    if (qos > 0) {
+        variable[variableLength++] = packetId >> 8;
+        variable[variableLength++] = packetId & 0xFF;
+    }
+
+    uint8_t header = MQTT_PUBLISH | (dup ? 0x08 : 0x00) | (qos << 1) | (retain ? 0x01 : 0x00);
+    return sendPacket(header, variable, variableLength, payload, length);
+}
+
+bool MQTTSession::sendPacket(uint8_t header, const uint8_t *variable, size_t variableLength,
+                             const uint8_t *payload, size_t payloadLength) {
+    // Fixed header and variable header go out in one write, the payload in a second
+    uint8_t packet[5 + MQTT_MAX_TOPIC_LENGTH + 4];
+    if (variableLength > sizeof(packet) - 5) {
+        return false;
+    }
+
+    size_t pos = 0;
+    packet[pos++] = header;
+    uint32_t remaining = variableLength + payloadLength;
+    do {
+        uint8_t digit = remaining & 0x7F;
+        remaining >>= 7;
+        packet[pos++] = digit | (remaining > 0 ? 0x80 : 0x00);
+    } while (remaining > 0);
+
+    memcpy(packet + pos, variable, variableLength);
+    pos += variableLength;
+
+    bool ok = client.write(packet, pos) == pos;
+    if (ok && payloadLength > 0) {
+        ok = client.write(payload, payloadLength) == payloadLength;
+    }
+    if (ok) {
+        lastOutbound = millis();
+    }
+    return ok;
+}
+
+bool MQTTSession::sendSimple(uint8_t header, uint16_t packetId) {
+    if (header == MQTT_PUBACK) {
+        const uint8_t variable[] = {(uint8_t)(packetId >> 8), (uint8_t)(packetId & 0xFF)};
+        return sendPacket(header, variable, sizeof(variable), nullptr, 0);
+    }
+    return sendPacket(header, nullptr, 0, nullptr, 0);
+}
+
+// Resend unacknowledged messages whose timer expired (or all of them after a reconnect)
+void MQTTSession::retransmitExpired(bool all) {
+    unsigned long now = millis();
+    for (auto &message : inflight) {
+        if (!message.used || (!all && now - message.sentAt < MQTT_RETRANSMIT_TIMEOUT)) {
+            continue;
+        }
+        sendPublish(message.topic, reinterpret_cast<const uint8_t *>(message.payload), message.payloadLength,
+                    message.retain, 1, true, message.packetId);
+        message.sentAt = now;
+        message.attempts++;
+        retransmits++;
+    }
+}
+
+// Feed available bytes through the packet parser without blocking
+void MQTTSession::readPackets() {
+    while (client.available() > 0) {
+        lastInbound = millis();
+
+        if (rxStage == RX_STAGE_BODY) {
+            uint32_t wanted = rxLength - rxReceived;
+            if (rxReceived < MQTT_RX_BUFFER_SIZE) {
+                wanted = min<uint32_t>(wanted, MQTT_RX_BUFFER_SIZE - rxReceived);
+                int read = client.read(rxBuffer + rxReceived, wanted);
+                if (read <= 0) {
+                    return;
+                }
+                rxReceived += read;
+            } else {
+                client.read();  // Oversized packet, discard the tail
+                rxReceived++;
+            }
+
+            if (rxReceived == rxLength) {
+                handlePacket();
+                rxStage = RX_STAGE_HEADER;
+            }
+            continue;
+        }
+
+        int value = client.read();
+        if (value < 0) {
+            return;
+        }
+
+        if (rxStage == RX_STAGE_HEADER) {
+            rxType = value;
+            rxLength = 0;
+            rxLengthShift = 0;
+            rxReceived = 0;
+            rxStage = RX_STAGE_LENGTH;
+        } else {
+            rxLength |= (uint32_t)(value & 0x7F) << rxLengthShift;
+            rxLengthShift += 7;
+            if (!(value & 0x80)) {
+                if (rxLength == 0) {
+                    handlePacket();
+                    rxStage = RX_STAGE_HEADER;
+                } else {
+                    rxStage = RX_STAGE_BODY;
+                }
+            }
+        }
+    }
+}
+
+void MQTTSession::handlePacket() {
+    size_t stored = min<uint32_t>(rxLength, MQTT_RX_BUFFER_SIZE);
+
+    switch (rxType & 0xF0) {
+        case MQTT_PUBACK: {
+            if (stored < 2) break;
+            uint16_t packetId = (rxBuffer[0] << 8) | rxBuffer[1];
+            for (auto &message : inflight) {
+                if (message.used && message.packetId == packetId) {
+                    message.used = false;
+                    inflightUsed--;
+                    acknowledged++;
+                    break;
+                }
+            }
+            break;
+        }
+
+        case MQTT_PUBLISH: {
+            uint8_t qos = (rxType >> 1) & 0x03;
+            if (stored < 2) break;
+            size_t topicLength = (rxBuffer[0] << 8) | rxBuffer[1];
+            size_t offset = 2 + topicLength + (qos > 0 ? 2 : 0);
+            if (offset > stored) break;
+
+            if (qos == 1) {
+                sendSimple(MQTT_PUBACK, (rxBuffer[2 + topicLength] << 8) | rxBuffer[3 + topicLength]);
+            }
+
+            // Only complete messages are delivered
+            if (callback && rxLength <= MQTT_RX_BUFFER_SIZE) {
+                // Shift the topic down over its length prefix to terminate it in place
+                memmove(rxBuffer, rxBuffer + 2, topicLength);
+                rxBuffer[topicLength] = '\0';
+                callback(reinterpret_cast<const char *>(rxBuffer), rxBuffer + offset, rxLength - offset);
+            }
+            break;
+        }
+
+        case MQTT_PINGRESP:
+            pingOutstanding = false;
+            break;
+
+        default:
+            break;  // SUBACK and anything unexpected
+    }
+}
+
+void MQTTSession::markDisconnected(int reason) {
+    currentState = reason;
+    awaitingConnack = false;
+    client.stop();
+    rxStage = RX_STAGE_HEADER;
+}
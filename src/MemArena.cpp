@@ -0,0 +1,126 @@
+#include "MemArena.h"
+
+// Every block is preceded by its size so reallocate() knows how much to copy
+struct BlockHeader {
+    size_t size;
+};
+
+static const size_t ALIGNMENT = alignof(max_align_t);
+
+static size_t alignUp(size_t value) {
+    return (value + ALIGNMENT - 1) & ~(ALIGNMENT - 1);
+}
+
+static const size_t HEADER_SIZE = alignUp(sizeof(BlockHeader));
+
+// Zero before any constructor runs, so arenas defined in other files can register in any order
+MemArena *MemArena::arenas = nullptr;
+
+MemArena::MemArena(const char *name, uint8_t *buffer, size_t capacity)
+    : label(name), buffer(buffer), size(capacity), offset(0), lastBlock(SIZE_MAX), highWater(0),
+      refused(0), nextArena(arenas) {
+    // Offsets are aligned relative to the start, so the start itself has to be aligned too.
+    // Xtensa faults on unaligned 32-bit loads and stores.
+    size_t skip = alignUp(reinterpret_cast<uintptr_t>(buffer)) - reinterpret_cast<uintptr_t>(buffer);
+    this->buffer = buffer + min(skip, capacity);
+    size = capacity - min(skip, capacity);
+    arenas = this;
+}
+
+void *MemArena::allocate(size_t requested) {
+    size_t needed = HEADER_SIZE + alignUp(requested);
+    if (offset + needed > size) {
+        refused++;
+        return nullptr;
+    }
+
+    BlockHeader *header = reinterpret_cast<BlockHeader *>(buffer + offset);
+    header->size = requested;
+    lastBlock = offset;
+    offset += needed;
+    highWater = max(highWater, offset);
+    return buffer + lastBlock + HEADER_SIZE;
+}
+
+void MemArena::deallocate(void *ptr) {
+    // Only the most recent block can be given back
+    if (ptr != nullptr && lastBlock != SIZE_MAX && ptr == buffer + lastBlock + HEADER_SIZE) {
+        offset = lastBlock;
+        lastBlock = SIZE_MAX;
+    }
+}
+
+void *MemArena::reallocate(void *ptr, size_t newSize) {
+    if (ptr == nullptr) {
+        return allocate(newSize);
+    }
+
+    BlockHeader *header = reinterpret_cast<BlockHeader *>(static_cast<uint8_t *>(ptr) - HEADER_SIZE);
+
+    // The most recent block is resized in place
+    if (lastBlock != SIZE_MAX && ptr == buffer + lastBlock + HEADER_SIZE) {
+        size_t end = lastBlock + HEADER_SIZE + alignUp(newSize);
+        if (end > size) {
+            refused++;
+            return nullptr;
+        }
+        header->size = newSize;
+        offset = end;
+        highWater = max(highWater, offset);
+        return ptr;
+    }
+
+    if (newSize <= header->size) {
+        header->size = newSize;  // Shrinking an older block, the tail is lost until reset()
+        return ptr;
+    }
+
+    void *moved = allocate(newSize);
+    if (moved != nullptr) {
+        memcpy(moved, ptr, header->size);
+    }
+    return moved;
+}
+
+size_t MemArena::mark() const {
+    return offset;
+}
+
+void MemArena::rewind(size_t mark) {
+    if (mark < offset) {
+        offset = mark;
+        lastBlock = SIZE_MAX;
+    }
+}
+
+void MemArena::reset() {
+    rewind(0);
+}
+
+const char *MemArena::name() const {
+    return label;
+}
+
+size_t MemArena::used() const {
+    return offset;
+}
+
+size_t MemArena::peak() const {
+    return highWater;
+}
+
+size_t MemArena::capacity() const {
+    return size;
+}
+
+uint32_t MemArena::failures() const {
+    return refused;
+}
+
+MemArena *MemArena::first() {
+    return arenas;
+}
+
+MemArena *MemArena::next() const {
+    return nextArena;
+}
@@ -0,0 +1,176 @@
+#include "MemStats.h"
+
+const size_t MEM_SUBSYSTEM_COUNT = static_cast<size_t>(MemSubsystem::Count);
+
+const char *const memSubsystemNames[] = {
+    "other",    // MemSubsystem::Other
+    "weather",  // MemSubsystem::Weather
+    "mqtt",     // MemSubsystem::MQTT
+    "web",      // MemSubsystem::Web
+    "display"   // MemSubsystem::Display
+};
+
+// Updated from any task, so only touched with atomic adds
+uint32_t totalAllocations = 0;
+uint32_t loopAllocations = 0;
+uint32_t subsystemAllocations[MEM_SUBSYSTEM_COUNT];
+uint32_t subsystemBytes[MEM_SUBSYSTEM_COUNT];
+
+TaskHandle_t loopTaskHandle = nullptr;
+MemSubsystem loopSubsystem = MemSubsystem::Other;  // Loop task only, set by MemScope
+
+struct MemTask {
+    TaskHandle_t task;
+    MemSubsystem subsystem;
+};
+
+MemTask memTasks[MEM_TASK_SLOTS];
+
+// Trace ring, written under a spinlock since any task may allocate
+portMUX_TYPE traceMux = portMUX_INITIALIZER_UNLOCKED;
+MemTraceEntry traceRing[MEM_TRACE ? MEM_TRACE_SIZE : 1];
+uint32_t traceWritten = 0;
+
+static MemSubsystem currentSubsystem() {
+    TaskHandle_t task = xTaskGetCurrentTaskHandle();
+    if (task == loopTaskHandle) {
+        return loopSubsystem;
+    }
+    for (const MemTask &entry : memTasks) {
+        if (entry.task == task) {
+            return entry.subsystem;
+        }
+    }
+    return MemSubsystem::Other;
+}
+
+// Nothing in here may allocate
+static void countAllocation(size_t size, void *caller) {
+    __atomic_add_fetch(&totalAllocations, 1, __ATOMIC_RELAXED);
+    if (loopTaskHandle == nullptr) {
+        return;  // Before beginMemStats()
+    }
+
+    MemSubsystem subsystem = currentSubsystem();
+    uint8_t index = static_cast<uint8_t>(subsystem);
+    __atomic_add_fetch(&subsystemAllocations[index], 1, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&subsystemBytes[index], size, __ATOMIC_RELAXED);
+    if (xTaskGetCurrentTaskHandle() == loopTaskHandle) {
+        __atomic_add_fetch(&loopAllocations, 1, __ATOMIC_RELAXED);
+    }
+
+    if (MEM_TRACE) {
+        uint32_t now = millis();
+        portENTER_CRITICAL(&traceMux);
+        MemTraceEntry &entry = traceRing[traceWritten % MEM_TRACE_SIZE];
+        entry.time = now;
+        entry.caller = (uint32_t)(uintptr_t)caller;
+        entry.size = size;
+        entry.subsystem = subsystem;
+        traceWritten++;
+        portEXIT_CRITICAL(&traceMux);
+    }
+}
+
+// Linker wrappers, see -Wl,--wrap in platformio.ini
+extern "C" {
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t count, size_t size);
+void *__real_realloc(void *ptr, size_t size);
+
+void *__wrap_malloc(size_t size) {
+    countAllocation(size, __builtin_return_address(0));
+    return __real_malloc(size);
+}
+
+void *__wrap_calloc(size_t count, size_t size) {
+    countAllocation(count * size, __builtin_return_address(0));
+    return __real_calloc(count, size);
+}
+
+void *__wrap_realloc(void *ptr, size_t size) {
+    countAllocation(size, __builtin_return_address(0));  // A String growing in place still went to the allocator
+    return __real_realloc(ptr, size);
+}
+}
+
+void beginMemStats() {
+    loopTaskHandle = xTaskGetCurrentTaskHandle();
+}
+
+uint32_t allocationCount() {
+    return __atomic_load_n(&totalAllocations, __ATOMIC_RELAXED);
+}
+
+uint32_t loopAllocationCount() {
+    return __atomic_load_n(&loopAllocations, __ATOMIC_RELAXED);
+}
+
+const char *memSubsystemName(MemSubsystem subsystem) {
+    uint8_t index = static_cast<uint8_t>(subsystem);
+    return index < MEM_SUBSYSTEM_COUNT ? memSubsystemNames[index] : "unknown";
+}
+
+void assignMemTask(TaskHandle_t task, MemSubsystem subsystem) {
+    if (task == nullptr) {
+        return;
+    }
+    for (MemTask &entry : memTasks) {
+        if (entry.task == nullptr || entry.task == task) {
+            entry.subsystem = subsystem;
+            entry.task = task;  // Published last, the allocator may be reading the table
+            return;
+        }
+    }
+}
+
+MemScope::MemScope(MemSubsystem subsystem)
+    : previous(loopSubsystem), active(xTaskGetCurrentTaskHandle() == loopTaskHandle) {
+    if (active) {
+        loopSubsystem = subsystem;
+    }
+}
+
+MemScope::~MemScope() {
+    if (active) {
+        loopSubsystem = previous;
+    }
+}
+
+void readMemSnapshot(MemSnapshot &snapshot) {
+    snapshot.freeHeap = ESP.getFreeHeap();
+    snapshot.largestBlock = ESP.getMaxAllocHeap();
+    snapshot.minFreeHeap = ESP.getMinFreeHeap();
+    snapshot.fragmentation = snapshot.freeHeap > 0 && snapshot.largestBlock < snapshot.freeHeap
+                                 ? 100 - (uint64_t)snapshot.largestBlock * 100 / snapshot.freeHeap
+                                 : 0;
+    for (size_t i = 0; i < MEM_SUBSYSTEM_COUNT; i++) {
+        snapshot.allocations[i] = __atomic_load_n(&subsystemAllocations[i], __ATOMIC_RELAXED);
+        snapshot.bytes[i] = __atomic_load_n(&subsystemBytes[i], __ATOMIC_RELAXED);
+    }
+}
+
+size_t readMemTrace(MemTraceEntry *entries, size_t maxEntries) {
+    if (!MEM_TRACE) {
+        return 0;
+    }
+
+    portENTER_CRITICAL(&traceMux);
+    size_t count = min<size_t>(min<uint32_t>(traceWritten, MEM_TRACE_SIZE), maxEntries);
+    uint32_t first = traceWritten - count;
+    for (size_t i = 0; i < count; i++) {
+        entries[i] = traceRing[(first + i) % MEM_TRACE_SIZE];
+    }
+    portEXIT_CRITICAL(&traceMux);
+    return count;
+}
+
+void formatMemory(size_t bytes, char *buffer, size_t size) {
+    if (bytes >= 1024 * 1024) {
+        snprintf(buffer, size, "%u MB", (unsigned)(bytes / (1024 * 1024)));
+    } else if (bytes >= 1024) {
+        snprintf(buffer, size, "%u KB", (unsigned)(bytes / 1024));
+    } else {
+        snprintf(buffer, size, "%u bytes", (unsigned)bytes);
+    }
+}
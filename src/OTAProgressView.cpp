@@ -0,0 +1,79 @@
+#include "OTAProgressView.h"
+
+// Layout on the 240x240 display
+const int16_t TITLE_Y = 10;
+const int16_t COUNTER_Y = 50;          // Byte count on the left, percentage on the right
+const int16_t PERCENT_X = 240 - 10 - 4 * 12;  // "100%" in size 2 text
+const int16_t BAR_X = 10;
+const int16_t BAR_Y = 80;
+const int16_t BAR_WIDTH = 220;
+const int16_t BAR_HEIGHT = 20;
+const int16_t DETAIL_Y = 110;
+const int16_t DETAIL_HEIGHT = 240 - DETAIL_Y;  // Long details wrap, so they may use the rest of the screen
+const uint32_t UNKNOWN_TOTAL_STEP = 16;  // KB between redraws when the size is unknown
+
+OTAProgressView::OTAProgressView(Adafruit_ST7789 &tft)
+    : tft(tft), drawnPercent(-1), drawnWidth(0), drawnKilobytes(0) {}
+
+void OTAProgressView::begin(const char *title) {
+    tft.fillScreen(ST77XX_BLACK);
+    tft.setTextSize(2);
+    tft.setTextColor(ST77XX_WHITE);
+    tft.setCursor(10, TITLE_Y);
+    tft.print(title);
+    tft.drawRect(BAR_X, BAR_Y, BAR_WIDTH, BAR_HEIGHT, ST77XX_WHITE);
+
+    drawnPercent = -1;
+    drawnWidth = 0;
+    drawnKilobytes = 0;
+}
+
+bool OTAProgressView::update(size_t done, size_t total) {
+    uint32_t kilobytes = done / 1024;
+    int percent = total > 0 ? (int)min<uint64_t>((uint64_t)done * 100 / total, 100) : 0;
+
+    bool changed = total > 0 ? percent != drawnPercent
+                             : drawnPercent < 0 || kilobytes - drawnKilobytes >= UNKNOWN_TOTAL_STEP;
+    if (!changed) {
+        return false;
+    }
+
+    // Opaque text, so the old digits are overwritten without clearing
+    tft.setTextSize(2);
+    tft.setTextColor(ST77XX_WHITE, ST77XX_BLACK);
+    tft.setCursor(10, COUNTER_Y);
+    tft.printf("%5u KB", (unsigned)kilobytes);
+    if (total > 0) {
+        tft.setCursor(PERCENT_X, COUNTER_Y);
+        tft.printf("%3d%%", percent);
+
+        // Only the part of the bar that is new since the last call
+        int16_t width = (int32_t)(BAR_WIDTH - 2) * percent / 100;
+        if (width > drawnWidth) {
+            tft.fillRect(BAR_X + 1 + drawnWidth, BAR_Y + 1, width - drawnWidth, BAR_HEIGHT - 2, ST77XX_GREEN);
+            drawnWidth = width;
+        }
+    }
+    tft.setTextColor(ST77XX_WHITE);
+
+    drawnPercent = percent;
+    drawnKilobytes = kilobytes;
+    return true;
+}
+
+void OTAProgressView::showResult(bool success, const char *detail) {
+    tft.fillRect(0, TITLE_Y, 240, 16, ST77XX_BLACK);
+    tft.setTextSize(2);
+    tft.setTextColor(success ? ST77XX_GREEN : ST77XX_RED);
+    tft.setCursor(10, TITLE_Y);
+    tft.print(success ? "Update Successful!" : "Update Failed!");
+
+    tft.fillRect(0, DETAIL_Y, 240, DETAIL_HEIGHT, ST77XX_BLACK);
+    if (detail != nullptr) {
+        tft.setTextSize(1);
+        tft.setTextColor(ST77XX_WHITE);
+        tft.setCursor(10, DETAIL_Y);
+        tft.print(detail);
+    }
+    tft.setTextColor(ST77XX_WHITE);
+}
@@ -1,48 +1,46 @@
 #include <ArduinoOTA.h>
-#include <Adafruit_GFX.h>
-#include <Adafruit_ST7789.h>
+#include "OTAUpdate.h"
+#include "DeviceIdentity.h"
 
-extern Adafruit_ST7789 tft;  // External reference to the display object
-
-void setupOTA(const char* otaPassword) {
+void setupOTA(const char* otaPassword, OTAProgressView &progressView) {
     ArduinoOTA.setPassword(otaPassword); // Set OTA password
-    ArduinoOTA.setHostname("weatherstation-kitchen");
+    ArduinoOTA.setHostname(getHostname());
     ArduinoOTA.begin();
 
     // Set up OTA callbacks
-    ArduinoOTA.onStart([]() {
+    ArduinoOTA.onStart([&progressView]() {
         String type = (ArduinoOTA.getCommand() == U_FLASH) ? "sketch" : "filesystem";
         Serial.println("Start updating " + type);
+        progressView.begin("Updating...");
     });
 
-    ArduinoOTA.onEnd([]() {
+    ArduinoOTA.onEnd([&progressView]() {
         Serial.println("\nEnd");
+        progressView.showResult(true, "Rebooting...");
     });
 
-    ArduinoOTA.onProgress([](unsigned int progress, unsigned int total) {
-        Serial.printf("Progress: %u%%\r", (progress / (total / 100)));
-        tft.fillScreen(ST77XX_BLACK);
-        tft.setCursor(10, 10);
-        tft.println("Updating...");
-        tft.setCursor(10, 50);
-        tft.print("Progress: ");
-        tft.print((progress / (total / 100)));
-        tft.println("%");
+    // Called for every received packet; the view only draws when the percentage changes
+    ArduinoOTA.onProgress([&progressView](unsigned int progress, unsigned int total) {
+        if (progressView.update(progress, total) && total > 0) {
+            Serial.printf("Progress: %u%%\r", (unsigned)((uint64_t)progress * 100 / total));
+        }
     });
 
-    ArduinoOTA.onError([](ota_error_t error) {
-        Serial.printf("Error[%u]: ", error);
+    ArduinoOTA.onError([&progressView](ota_error_t error) {
+        const char *reason = "Unknown error";
         if (error == OTA_AUTH_ERROR) {
-            Serial.println("Auth Failed");
+            reason = "Auth Failed";
         } else if (error == OTA_BEGIN_ERROR) {
-            Serial.println("Begin Failed");
+            reason = "Begin Failed";
         } else if (error == OTA_CONNECT_ERROR) {
-            Serial.println("Connect Failed");
+            reason = "Connect Failed";
         } else if (error == OTA_RECEIVE_ERROR) {
-            Serial.println("Receive Failed");
+            reason = "Receive Failed";
         } else if (error == OTA_END_ERROR) {
-            Serial.println("End Failed");
+            reason = "End Failed";
         }
+        Serial.printf("Error[%u]: %s\n", error, reason);
+        progressView.showResult(false, reason);
     });
 }
 
@@ -0,0 +1,191 @@
+#include "OfflineQueue.h"
+#include <SPIFFS.h>
+#include <Preferences.h>
+
+// NVS location of the spill read cursor
+static const char *CURSOR_NAMESPACE = "offlineq";
+static const char *CURSOR_KEY = "read";
+
+OfflineQueue::OfflineQueue(const char *spillPath)
+    : spillPath(spillPath), spillAvailable(false), ringHead(0), ringCount(0),
+      spillWritten(0), spillRead(0), readBufferPos(0), readBufferCount(0), previousBootSamples(0), dropped(0) {}
+
+void OfflineQueue::begin() {
+    spillAvailable = SPIFFS.begin(true);  // Format on first use
+    if (!spillAvailable) {
+        Serial.println("Offline queue: SPIFFS mount failed, RAM only");
+        return;
+    }
+
+    // Pick up samples that were spilled before the last reboot
+    if (SPIFFS.exists(spillPath)) {
+        File file = SPIFFS.open(spillPath, FILE_READ);
+        spillWritten = file.size() / sizeof(QueuedSample);
+        previousBootSamples = spillWritten;
+        file.close();
+
+        // Skip whatever was already published before the reboot
+        Preferences prefs;
+        if (prefs.begin(CURSOR_NAMESPACE, true)) {
+            size_t cursor = prefs.getUInt(CURSOR_KEY, 0);
+            prefs.end();
+            if (cursor <= spillWritten) {
+                spillRead = cursor;
+            }
+        }
+        Serial.printf("Offline queue: %u samples pending in flash\n", (unsigned)(spillWritten - spillRead));
+    } else {
+        saveCursor(0);
+    }
+}
+
+void OfflineQueue::push(const QueuedSample &sample) {
+    if (ringCount == OFFLINE_QUEUE_CAPACITY) {
+        spillOldest();
+    }
+
+    if (ringCount == OFFLINE_QUEUE_CAPACITY) {
+        // Spilling was not possible, drop the oldest sample to make room for the newest
+        ringHead = (ringHead + 1) % OFFLINE_QUEUE_CAPACITY;
+        ringCount--;
+        dropped++;
+    }
+
+    ring[(ringHead + ringCount) % OFFLINE_QUEUE_CAPACITY] = sample;
+    ringCount++;
+}
+
+bool OfflineQueue::peek(QueuedSample &sample) {
+    // Oldest samples live in flash, so serve those first
+    if (readBufferPos < readBufferCount || refillFromSpill()) {
+        sample = readBuffer[readBufferPos];
+        return true;
+    }
+
+    if (ringCount > 0) {
+        sample = ring[ringHead];
+        return true;
+    }
+
+    return false;
+}
+
+void OfflineQueue::pop() {
+    if (readBufferPos < readBufferCount) {
+        readBufferPos++;
+
+        if (readBufferPos == readBufferCount) {
+            if (spillRead == spillWritten) {
+                // Everything in the spill file has been consumed
+                removeSpill();
+            } else {
+                saveCursor(spillRead);
+            }
+        }
+        return;
+    }
+
+    if (ringCount > 0) {
+        ringHead = (ringHead + 1) % OFFLINE_QUEUE_CAPACITY;
+        ringCount--;
+    }
+}
+
+size_t OfflineQueue::size() const {
+    return ringCount + (readBufferCount - readBufferPos) + (spillWritten - spillRead);
+}
+
+bool OfflineQueue::empty() const {
+    return size() == 0;
+}
+
+uint32_t OfflineQueue::droppedCount() const {
+    return dropped;
+}
+
+// Move the oldest batch of samples from RAM into the spill file
+void OfflineQueue::spillOldest() {
+    if (!spillAvailable || spillWritten + OFFLINE_QUEUE_SPILL_BATCH > OFFLINE_QUEUE_SPILL_MAX) {
+        return;
+    }
+
+    File file = SPIFFS.open(spillPath, FILE_APPEND);
+    if (!file) {
+        return;
+    }
+
+    size_t spilled = 0;
+    while (spilled < OFFLINE_QUEUE_SPILL_BATCH && ringCount > 0) {
+        if (file.write(reinterpret_cast<const uint8_t *>(&ring[ringHead]), sizeof(QueuedSample)) != sizeof(QueuedSample)) {
+            break;  // Flash full, keep the rest in RAM
+        }
+        ringHead = (ringHead + 1) % OFFLINE_QUEUE_CAPACITY;
+        ringCount--;
+        spilled++;
+    }
+    file.close();
+
+    spillWritten += spilled;
+}
+
+// Read the next batch of spilled samples back into the read buffer
+bool OfflineQueue::refillFromSpill() {
+    readBufferPos = 0;
+    readBufferCount = 0;
+    if (spillRead == spillWritten) {
+        return false;  // Nothing in flash
+    }
+
+    while (readBufferCount == 0 && spillRead < spillWritten) {
+        File file = SPIFFS.open(spillPath, FILE_READ);
+        if (!file || !file.seek(spillRead * sizeof(QueuedSample))) {
+            return false;
+        }
+
+        size_t wanted = min<size_t>(OFFLINE_QUEUE_READ_BATCH, spillWritten - spillRead);
+        size_t bytes = file.read(reinterpret_cast<uint8_t *>(readBuffer), wanted * sizeof(QueuedSample));
+        file.close();
+
+        size_t count = bytes / sizeof(QueuedSample);
+        if (count == 0) {
+            break;  // Truncated file
+        }
+
+        // Keep the samples that can still be placed on the timeline
+        for (size_t i = 0; i < count; i++) {
+            if (spillRead + i < previousBootSamples && (readBuffer[i].flags & SAMPLE_FLAG_UPTIME)) {
+                dropped++;
+            } else {
+                readBuffer[readBufferCount++] = readBuffer[i];
+            }
+        }
+        spillRead += count;
+    }
+
+    if (readBufferCount == 0) {
+        // Everything left was unusable or the file is truncated, give up on the remainder
+        removeSpill();
+        return false;
+    }
+    return true;
+}
+
+// Remember how far the spill file has been consumed, so a reboot does not publish it twice
+void OfflineQueue::saveCursor(size_t cursor) {
+    Preferences prefs;
+    if (prefs.begin(CURSOR_NAMESPACE, false)) {
+        if (prefs.getUInt(CURSOR_KEY, 0) != cursor) {
+            prefs.putUInt(CURSOR_KEY, cursor);
+        }
+        prefs.end();
+    }
+}
+
+void OfflineQueue::removeSpill() {
+    // Reset the cursor first, a stale one would skip samples of the next spill file
+    saveCursor(0);
+    SPIFFS.remove(spillPath);
+    spillWritten = 0;
+    spillRead = 0;
+    previousBootSamples = 0;
+}
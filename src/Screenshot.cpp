@@ -0,0 +1,98 @@
+#include "Screenshot.h"
+#include "ShadowedST7789.h"
+
+extern ShadowedST7789 tft;  // External reference to the display object
+
+const size_t BMP_FILE_HEADER = 14;
+const size_t BMP_INFO_HEADER = 40;
+const size_t BMP_PALETTE = 256 * 4;
+const size_t BMP_PIXELS_OFFSET = BMP_FILE_HEADER + BMP_INFO_HEADER + BMP_PALETTE;
+
+uint8_t bmpHeader[BMP_FILE_HEADER + BMP_INFO_HEADER];
+size_t bmpRowSize = 0;  // Rows are padded to 4 bytes
+size_t bmpSize = 0;
+
+static void putUint16(uint8_t *buffer, uint16_t value) {
+    buffer[0] = value;
+    buffer[1] = value >> 8;
+}
+
+static void putUint32(uint8_t *buffer, uint32_t value) {
+    putUint16(buffer, value);
+    putUint16(buffer + 2, value >> 16);
+}
+
+static void buildHeader(int16_t width, int16_t height) {
+    bmpRowSize = (width + 3) & ~3;
+    bmpSize = BMP_PIXELS_OFFSET + bmpRowSize * height;
+
+    memset(bmpHeader, 0, sizeof(bmpHeader));
+    bmpHeader[0] = 'B';
+    bmpHeader[1] = 'M';
+    putUint32(bmpHeader + 2, bmpSize);
+    putUint32(bmpHeader + 10, BMP_PIXELS_OFFSET);
+
+    uint8_t *info = bmpHeader + BMP_FILE_HEADER;
+    putUint32(info, BMP_INFO_HEADER);
+    putUint32(info + 4, width);
+    putUint32(info + 8, height);  // Positive: bottom-up rows, what every viewer understands
+    putUint16(info + 12, 1);      // Planes
+    putUint16(info + 14, 8);      // Bits per pixel
+    putUint32(info + 20, bmpRowSize * height);
+    putUint32(info + 24, 2835);   // 72 DPI
+    putUint32(info + 28, 2835);
+    putUint32(info + 32, 256);    // Palette entries
+}
+
+// Byte of the palette: entry i is the RGB332 value i, stored as blue, green, red, 0
+static uint8_t paletteByte(size_t offset) {
+    uint8_t entry = offset / 4;
+    switch (offset % 4) {
+        case 0: return (entry & 0x03) * 255 / 3;
+        case 1: return ((entry >> 2) & 0x07) * 255 / 7;
+        case 2: return (entry >> 5) * 255 / 7;
+        default: return 0;
+    }
+}
+
+// Fill the next part of the file at index, called on the AsyncTCP task
+static size_t fillScreenshot(uint8_t *buffer, size_t maxLen, size_t index) {
+    size_t written = 0;
+    while (written < maxLen && index < bmpSize) {
+        if (index < sizeof(bmpHeader)) {
+            size_t chunk = min(maxLen - written, sizeof(bmpHeader) - index);
+            memcpy(buffer + written, bmpHeader + index, chunk);
+            written += chunk;
+            index += chunk;
+        } else if (index < BMP_PIXELS_OFFSET) {
+            buffer[written++] = paletteByte(index - sizeof(bmpHeader));
+            index++;
+        } else {
+            // Bottom row first
+            size_t pixel = index - BMP_PIXELS_OFFSET;
+            int16_t row = tft.height() - 1 - pixel / bmpRowSize;
+            size_t column = pixel % bmpRowSize;
+            size_t chunk = min(maxLen - written, bmpRowSize - column);
+            size_t visible = column < (size_t)tft.width() ? min(chunk, tft.width() - column) : 0;
+            memcpy(buffer + written, tft.shadowRow(row) + column, visible);
+            memset(buffer + written + visible, 0, chunk - visible);  // Row padding
+            written += chunk;
+            index += chunk;
+        }
+    }
+    return written;
+}
+
+void setupScreenshot(AsyncWebServer &server) {
+    buildHeader(tft.width(), tft.height());
+
+    server.on("/screenshot.bmp", HTTP_GET, [](AsyncWebServerRequest *request) {
+        if (!tft.hasShadow()) {
+            request->send(503, "text/plain", "Display shadow not available");
+            return;
+        }
+        AsyncWebServerResponse *response = request->beginResponse("image/bmp", bmpSize, fillScreenshot);
+        response->addHeader("Cache-Control", "no-store");
+        request->send(response);
+    });
+}
@@ -0,0 +1,316 @@
+#include "SensorHistory.h"
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include <stdarg.h>
+#include <time.h>
+#include <memory>
+
+const size_t HISTORY_METRIC_COUNT = static_cast<size_t>(HistoryMetric::Count);
+const int16_t HISTORY_NO_VALUE = INT16_MIN;
+
+// Column names for the metric= parameter and the export, and how each value is stored
+struct HistoryColumn {
+    const char *name;
+    int16_t scale;  // Stored value = reading * scale
+};
+
+const HistoryColumn historyColumns[] = {
+    {"temperature", 10},  // HistoryMetric::Temperature
+    {"humidity", 10},     // HistoryMetric::Humidity
+    {"mq5", 10},          // HistoryMetric::MQ5Percentage
+    {"rssi", 1}           // HistoryMetric::WiFiSignal
+};
+
+// 12 bytes per sample. Time is kept as uptime and turned into epoch seconds on export,
+// so samples taken before NTP answered line up with the rest.
+struct HistorySample {
+    uint32_t uptime;  // Seconds since boot
+    int16_t values[HISTORY_METRIC_COUNT];
+};
+
+// Written by the loop task, read by the AsyncTCP task while exporting
+HistorySample historyRing[HISTORY_CAPACITY];
+uint32_t historyWritten = 0;  // Samples stored since boot; sample n lives at n % HISTORY_CAPACITY
+SemaphoreHandle_t historyMutex = nullptr;
+unsigned long lastHistorySample = 0;
+
+// State of one export, everything the encoder needs between two chunks
+struct HistoryExport {
+    enum class Stage : uint8_t { Header, Rows, Footer, Done };
+
+    Stage stage = Stage::Header;
+    bool json = false;
+    uint8_t columns = 0;      // Bit per HistoryMetric
+    uint32_t bootEpoch = 0;   // Epoch seconds at boot, 0 if the clock is not set (times are then uptime)
+    uint32_t from = 0;        // In export time, inclusive
+    uint32_t to = UINT32_MAX;
+    uint32_t step = 0;        // 0: every sample
+    uint32_t next = 0;        // Next sample to read from the ring
+    uint32_t end = 0;         // Samples stored when the request came in
+    bool firstRow = true;
+
+    // Samples copied out of the ring
+    HistorySample batch[HISTORY_READ_BATCH];
+    uint8_t batchPosition = 0;
+    uint8_t batchCount = 0;
+
+    // Step being averaged
+    bool bucketOpen = false;
+    uint32_t bucketStart = 0;
+    int32_t sums[HISTORY_METRIC_COUNT];
+    uint16_t counts[HISTORY_METRIC_COUNT];
+
+    // Formatted line not yet handed out completely
+    char line[HISTORY_LINE_SIZE];
+    size_t lineLength = 0;
+    size_t linePosition = 0;
+};
+
+static int16_t toStored(float value, int16_t scale) {
+    return isnan(value) ? HISTORY_NO_VALUE : (int16_t)lroundf(constrain(value * scale, -32767.0f, 32767.0f));
+}
+
+void recordSensorHistory(float temperature, float humidity, float mq5Percentage, int wifiSignalStrength) {
+    if (historyMutex == nullptr || (historyWritten > 0 && millis() - lastHistorySample < HISTORY_INTERVAL)) {
+        return;
+    }
+    lastHistorySample = millis();
+
+    HistorySample sample;
+    sample.uptime = millis() / 1000;
+    sample.values[static_cast<uint8_t>(HistoryMetric::Temperature)] = toStored(temperature, 10);
+    sample.values[static_cast<uint8_t>(HistoryMetric::Humidity)] = toStored(humidity, 10);
+    sample.values[static_cast<uint8_t>(HistoryMetric::MQ5Percentage)] = toStored(mq5Percentage, 10);
+    sample.values[static_cast<uint8_t>(HistoryMetric::WiFiSignal)] = wifiSignalStrength;
+
+    xSemaphoreTake(historyMutex, portMAX_DELAY);
+    historyRing[historyWritten % HISTORY_CAPACITY] = sample;
+    historyWritten++;
+    xSemaphoreGive(historyMutex);
+}
+
+// Copy the next few samples out of the ring, returns false once the export range is used up
+static bool readBatch(HistoryExport &history) {
+    xSemaphoreTake(historyMutex, portMAX_DELAY);
+    uint32_t oldest = historyWritten > HISTORY_CAPACITY ? historyWritten - HISTORY_CAPACITY : 0;
+    if (history.next < oldest) {
+        history.next = oldest;  // Overwritten while we were sending
+    }
+    uint8_t count = min<uint32_t>(HISTORY_READ_BATCH, history.end - history.next);
+    for (uint8_t i = 0; i < count; i++) {
+        history.batch[i] = historyRing[(history.next + i) % HISTORY_CAPACITY];
+    }
+    xSemaphoreGive(historyMutex);
+
+    history.next += count;
+    history.batchPosition = 0;
+    history.batchCount = count;
+    return count > 0;
+}
+
+static void appendLine(HistoryExport &history, const char *format, ...) __attribute__((format(printf, 2, 3)));
+
+static void appendLine(HistoryExport &history, const char *format, ...) {
+    if (history.lineLength >= sizeof(history.line) - 1) {
+        return;
+    }
+    va_list args;
+    va_start(args, format);
+    int written = vsnprintf(history.line + history.lineLength, sizeof(history.line) - history.lineLength, format, args);
+    va_end(args);
+    if (written > 0) {
+        history.lineLength = min(history.lineLength + written, sizeof(history.line) - 1);
+    }
+}
+
+// One row; values are in stored units, count 0 means no value
+static void formatRow(HistoryExport &history, uint32_t time, const int32_t *sums, const uint16_t *counts) {
+    history.lineLength = 0;
+    history.linePosition = 0;
+    appendLine(history, history.json ? (history.firstRow ? "[%u" : ",[%u") : "%u", (unsigned)time);
+    history.firstRow = false;
+
+    for (size_t i = 0; i < HISTORY_METRIC_COUNT; i++) {
+        if (!(history.columns & (1 << i))) {
+            continue;
+        }
+        if (counts[i] == 0) {
+            appendLine(history, history.json ? ",null" : ",");
+        } else {
+            float value = (float)sums[i] / counts[i] / historyColumns[i].scale;
+            appendLine(history, historyColumns[i].scale > 1 ? ",%.1f" : ",%.0f", value);
+        }
+    }
+    appendLine(history, history.json ? "]" : "\n");
+}
+
+static void openBucket(HistoryExport &history, uint32_t start) {
+    history.bucketOpen = true;
+    history.bucketStart = start;
+    memset(history.sums, 0, sizeof(history.sums));
+    memset(history.counts, 0, sizeof(history.counts));
+}
+
+static void addToBucket(HistoryExport &history, const HistorySample &sample) {
+    for (size_t i = 0; i < HISTORY_METRIC_COUNT; i++) {
+        if (sample.values[i] != HISTORY_NO_VALUE) {
+            history.sums[i] += sample.values[i];
+            history.counts[i]++;
+        }
+    }
+}
+
+// Produce the next row from the samples, false once they are used up
+static bool nextRow(HistoryExport &history) {
+    while (history.batchPosition < history.batchCount || readBatch(history)) {
+        const HistorySample &sample = history.batch[history.batchPosition++];
+        uint32_t time = history.bootEpoch + sample.uptime;
+        if (time < history.from) {
+            continue;
+        }
+        if (time > history.to) {
+            history.next = history.end;  // Samples are in time order, nothing further matches
+            history.batchCount = 0;
+            break;
+        }
+
+        uint32_t bucket = history.step > 0 ? time - time % history.step : time;
+        if (history.bucketOpen && bucket == history.bucketStart) {
+            addToBucket(history, sample);
+            continue;
+        }
+
+        // A new step starts, the previous one (if any) is complete
+        bool emitted = history.bucketOpen;
+        if (emitted) {
+            formatRow(history, history.bucketStart, history.sums, history.counts);
+        }
+        openBucket(history, bucket);
+        addToBucket(history, sample);
+        if (emitted) {
+            return true;
+        }
+    }
+
+    if (history.bucketOpen) {
+        formatRow(history, history.bucketStart, history.sums, history.counts);
+        history.bucketOpen = false;
+        return true;
+    }
+    return false;
+}
+
+// Format the next line of the export into history.line, false when there is nothing left
+static bool nextLine(HistoryExport &history) {
+    history.lineLength = 0;
+    history.linePosition = 0;
+
+    switch (history.stage) {
+        case HistoryExport::Stage::Header:
+            appendLine(history, history.json ? "{\"columns\":[\"time\"" : "time");
+            for (size_t i = 0; i < HISTORY_METRIC_COUNT; i++) {
+                if (history.columns & (1 << i)) {
+                    appendLine(history, history.json ? ",\"%s\"" : ",%s", historyColumns[i].name);
+                }
+            }
+            appendLine(history, history.json ? "],\"step\":%u,\"rows\":[" : "\n", (unsigned)history.step);
+            history.stage = HistoryExport::Stage::Rows;
+            return true;
+
+        case HistoryExport::Stage::Rows:
+            if (nextRow(history)) {
+                return true;
+            }
+            history.stage = HistoryExport::Stage::Footer;
+            // fall through
+
+        case HistoryExport::Stage::Footer:
+            history.stage = HistoryExport::Stage::Done;
+            if (history.json) {
+                appendLine(history, "]}\n");
+                return true;
+            }
+            return false;
+
+        default:
+            return false;
+    }
+}
+
+// Chunk filler: hand out formatted lines until the chunk is full, 0 ends the response
+static size_t fillHistory(HistoryExport &history, uint8_t *buffer, size_t maxLen) {
+    size_t written = 0;
+    while (written < maxLen) {
+        if (history.linePosition == history.lineLength && !nextLine(history)) {
+            break;
+        }
+        size_t chunk = min(maxLen - written, history.lineLength - history.linePosition);
+        memcpy(buffer + written, history.line + history.linePosition, chunk);
+        history.linePosition += chunk;
+        written += chunk;
+    }
+    return written;
+}
+
+// from= and to= are absolute, or relative to now when negative
+static uint32_t parseTime(AsyncWebServerRequest *request, const char *name, uint32_t now, uint32_t fallback) {
+    if (!request->hasParam(name)) {
+        return fallback;
+    }
+    long value = request->getParam(name)->value().toInt();
+    if (value < 0) {
+        return (uint32_t)-value < now ? now + value : 0;
+    }
+    return value;
+}
+
+static void handleHistoryRequest(AsyncWebServerRequest *request) {
+    std::shared_ptr<HistoryExport> history = std::make_shared<HistoryExport>();
+
+    history->columns = (1 << HISTORY_METRIC_COUNT) - 1;
+    if (request->hasParam("metric")) {
+        const String &metric = request->getParam("metric")->value();
+        history->columns = 0;
+        for (size_t i = 0; i < HISTORY_METRIC_COUNT; i++) {
+            if (metric == historyColumns[i].name) {
+                history->columns = 1 << i;
+            }
+        }
+        if (history->columns == 0) {
+            request->send(400, "text/plain", "Unknown metric");
+            return;
+        }
+    }
+    if (request->hasParam("format")) {
+        history->json = request->getParam("format")->value() == "json";
+    }
+    if (request->hasParam("step")) {
+        history->step = max(request->getParam("step")->value().toInt(), 0L);
+    }
+
+    // Times are epoch seconds once NTP has set the clock, seconds since boot before that
+    uint32_t uptime = millis() / 1000;
+    time_t epoch = time(nullptr);
+    history->bootEpoch = epoch > 1600000000 ? (uint32_t)epoch - uptime : 0;
+    uint32_t now = history->bootEpoch + uptime;
+    history->from = parseTime(request, "from", now, 0);
+    history->to = parseTime(request, "to", now, UINT32_MAX);
+
+    xSemaphoreTake(historyMutex, portMAX_DELAY);
+    history->end = historyWritten;
+    history->next = historyWritten > HISTORY_CAPACITY ? historyWritten - HISTORY_CAPACITY : 0;
+    xSemaphoreGive(historyMutex);
+
+    AsyncWebServerResponse *response = request->beginChunkedResponse(
+        history->json ? "application/json" : "text/csv",
+        [history](uint8_t *buffer, size_t maxLen, size_t index) -> size_t {
+            return fillHistory(*history, buffer, maxLen);
+        });
+    response->addHeader("Cache-Control", "no-cache");
+    request->send(response);
+}
+
+void setupSensorHistory(AsyncWebServer &server) {
+    historyMutex = xSemaphoreCreateMutex();
+    server.on("/api/history", HTTP_GET, handleHistoryRequest);
+}
@@ -0,0 +1,101 @@
+#include "ShadowedST7789.h"
+
+ShadowedST7789::ShadowedST7789(int8_t cs, int8_t dc, int8_t rst)
+    : Adafruit_ST7789(cs, dc, rst), shadow(nullptr), shadowWidth(0), shadowHeight(0) {}
+
+bool ShadowedST7789::beginShadow() {
+    if (!DISPLAY_SHADOW || shadow != nullptr) {
+        return shadow != nullptr;
+    }
+    shadow = (uint8_t *)calloc((size_t)width() * height(), 1);  // Black, like the panel after init
+    if (shadow == nullptr) {
+        Serial.println("Display shadow: out of memory");
+        return false;
+    }
+    shadowWidth = width();
+    shadowHeight = height();
+    return true;
+}
+
+bool ShadowedST7789::hasShadow() const {
+    return shadow != nullptr;
+}
+
+const uint8_t *ShadowedST7789::shadowRow(int16_t y) const {
+    return shadow + (size_t)y * shadowWidth;
+}
+
+uint8_t ShadowedST7789::toRGB332(uint16_t color) {
+    return ((color >> 8) & 0xE0) | ((color >> 6) & 0x1C) | ((color >> 3) & 0x03);
+}
+
+// Clip to the shadow and fill it; the panel clips on its own
+void ShadowedST7789::shadowRect(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color) {
+    if (shadow == nullptr) {
+        return;
+    }
+    if (w < 0) {
+        x += w + 1;
+        w = -w;
+    }
+    if (h < 0) {
+        y += h + 1;
+        h = -h;
+    }
+    int16_t x1 = min<int16_t>(x + w, shadowWidth);
+    int16_t y1 = min<int16_t>(y + h, shadowHeight);
+    x = max<int16_t>(x, 0);
+    y = max<int16_t>(y, 0);
+    if (x >= x1 || y >= y1) {
+        return;
+    }
+
+    uint8_t value = toRGB332(color);
+    for (int16_t row = y; row < y1; row++) {
+        memset(shadow + (size_t)row * shadowWidth + x, value, x1 - x);
+    }
+}
+
+void ShadowedST7789::drawPixel(int16_t x, int16_t y, uint16_t color) {
+    Adafruit_ST7789::drawPixel(x, y, color);
+    if (shadow != nullptr && x >= 0 && y >= 0 && x < shadowWidth && y < shadowHeight) {
+        shadow[(size_t)y * shadowWidth + x] = toRGB332(color);
+    }
+}
+
+void ShadowedST7789::writePixel(int16_t x, int16_t y, uint16_t color) {
+    Adafruit_ST7789::writePixel(x, y, color);
+    if (shadow != nullptr && x >= 0 && y >= 0 && x < shadowWidth && y < shadowHeight) {
+        shadow[(size_t)y * shadowWidth + x] = toRGB332(color);
+    }
+}
+
+void ShadowedST7789::fillRect(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color) {
+    Adafruit_ST7789::fillRect(x, y, w, h, color);
+    shadowRect(x, y, w, h, color);
+}
+
+void ShadowedST7789::writeFillRect(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color) {
+    Adafruit_ST7789::writeFillRect(x, y, w, h, color);
+    shadowRect(x, y, w, h, color);
+}
+
+void ShadowedST7789::drawFastHLine(int16_t x, int16_t y, int16_t w, uint16_t color) {
+    Adafruit_ST7789::drawFastHLine(x, y, w, color);
+    shadowRect(x, y, w, 1, color);
+}
+
+void ShadowedST7789::writeFastHLine(int16_t x, int16_t y, int16_t w, uint16_t color) {
+    Adafruit_ST7789::writeFastHLine(x, y, w, color);
+    shadowRect(x, y, w, 1, color);
+}
+
+void ShadowedST7789::drawFastVLine(int16_t x, int16_t y, int16_t h, uint16_t color) {
+    Adafruit_ST7789::drawFastVLine(x, y, h, color);
+    shadowRect(x, y, 1, h, color);
+}
+
+void ShadowedST7789::writeFastVLine(int16_t x, int16_t y, int16_t h, uint16_t color) {
+    Adafruit_ST7789::writeFastVLine(x, y, h, color);
+    shadowRect(x, y, 1, h, color);
+}
@@ -0,0 +1,438 @@
+#include "Telemetry.h"
+#include "MQTTHandler.h"
+#include "WeatherHttpSession.h"
+#include "WeatherPage.h"
+#include "MemStats.h"
+#include "MemArena.h"
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include <stdarg.h>
+#include <memory>
+
+extern WeatherHttpSession weatherHttp;
+extern WeatherPage weatherPage;
+
+const uint32_t NO_WEATHER_DATA = UINT32_MAX;
+
+// Everything the endpoints report. Kept flat and zeroed before filling, so snapshots compare with memcmp.
+// The fields from uptime on drift with every sample and are left out of the comparison.
+struct TelemetryState {
+    float temperature;
+    float humidity;
+    float mq5Percentage;
+    char gasQuality[16];
+    bool gasAlarm;
+    bool mqttConnected;
+    int32_t wifiRssi;
+    struct {
+        const char *name;
+        uint32_t capacity;
+        uint32_t peak;
+        uint32_t failures;
+    } arenas[TELEMETRY_ARENA_SLOTS];
+    uint8_t arenaCount;
+    uint32_t mqttConnects;
+    uint32_t mqttPublished;
+    uint32_t mqttDowngraded;
+    uint32_t mqttAcknowledged;
+    uint32_t mqttRetransmits;
+    uint32_t mqttQueued;
+    uint32_t mqttDropped;
+    uint32_t weatherRequests;
+    uint32_t weatherReused;
+    uint32_t weatherNotModified;
+    uint32_t weatherFailed;
+    uint32_t weatherThrottled;
+
+    // Not compared, see TELEMETRY_COMPARED_SIZE. These move every second, or whenever any task
+    // touches the heap, and go out with the next render caused by one of the fields above.
+    uint32_t uptime;  // Seconds
+    uint32_t weatherAge;  // Seconds since the last successful fetch, NO_WEATHER_DATA if none
+    uint32_t freeHeap;
+    uint32_t minFreeHeap;
+    uint32_t maxAllocHeap;
+    uint32_t fragmentation;  // Percent of the free heap outside the largest block
+    uint32_t allocations;  // All tasks since boot
+    uint32_t subsystemAllocations[static_cast<size_t>(MemSubsystem::Count)];
+    uint32_t subsystemBytes[static_cast<size_t>(MemSubsystem::Count)];
+    uint32_t loopCount;
+    uint32_t loopAverage;  // Microseconds, over the last sample interval
+    uint32_t loopMax;
+    uint32_t loopAllocations;  // Over the last sample interval
+    uint32_t loopAllocationsMax;  // Most in one pass
+};
+
+// A new snapshot only counts as a change, and triggers a re-render, if this part differs
+const size_t TELEMETRY_COMPARED_SIZE = offsetof(TelemetryState, uptime);
+
+// One endpoint's output. Two slots, so a render that is still being sent is never overwritten.
+struct TelemetryDocument {
+    char *text[2];
+    size_t capacity;
+    size_t length[2];
+    uint32_t version[2];
+    uint8_t readers[2];  // Responses still sending from the slot, released in the request's onDisconnect
+    uint8_t front;
+    size_t (*render)(char *buffer, size_t capacity, const TelemetryState &state);
+};
+
+// Written by the loop task, read by the AsyncTCP task
+SemaphoreHandle_t telemetryMutex = nullptr;
+TelemetryState telemetryState;
+uint32_t telemetryVersion = 0;  // 0 until the first snapshot
+
+// Loop task only
+unsigned long lastTelemetrySample = 0;
+uint32_t loopCount = 0;
+uint32_t loopTimeSum = 0;
+uint32_t loopTimeSamples = 0;
+uint32_t loopTimeMax = 0;
+uint32_t loopAllocationSum = 0;
+uint32_t loopAllocationMax = 0;
+
+// AsyncTCP task only
+char metricsText[2][TELEMETRY_METRICS_SIZE];
+char stateText[2][TELEMETRY_STATE_SIZE];
+
+// Appends formatted text to a fixed buffer, stopping once it is full
+struct BufferWriter {
+    char *buffer;
+    size_t capacity;
+    size_t length;
+
+    void printf(const char *format, ...) __attribute__((format(printf, 2, 3))) {
+        if (length + 1 >= capacity) {
+            return;
+        }
+        va_list args;
+        va_start(args, format);
+        int written = vsnprintf(buffer + length, capacity - length, format, args);
+        va_end(args);
+        if (written > 0) {
+            length = min(length + written, capacity - 1);
+        }
+    }
+};
+
+// Prometheus sample with its HELP and TYPE lines
+static void writeMetric(BufferWriter &out, const char *name, const char *type, const char *help, uint32_t value) {
+    out.printf("# HELP weatherstation_%s %s\n# TYPE weatherstation_%s %s\nweatherstation_%s %u\n",
+               name, help, name, type, name, (unsigned)value);
+}
+
+static void writeMetric(BufferWriter &out, const char *name, const char *type, const char *help, float value) {
+    out.printf("# HELP weatherstation_%s %s\n# TYPE weatherstation_%s %s\n", name, help, name, type);
+    if (isnan(value)) {
+        out.printf("weatherstation_%s NaN\n", name);
+    } else {
+        out.printf("weatherstation_%s %g\n", name, value);
+    }
+}
+
+static size_t renderMetrics(char *buffer, size_t capacity, const TelemetryState &state) {
+    BufferWriter out = {buffer, capacity, 0};
+    buffer[0] = '\0';
+
+    writeMetric(out, "temperature_celsius", "gauge", "DHT temperature", state.temperature);
+    writeMetric(out, "humidity_percent", "gauge", "DHT relative humidity", state.humidity);
+    writeMetric(out, "mq5_percent", "gauge", "MQ-5 gas level", state.mq5Percentage);
+    out.printf("# HELP weatherstation_gas_quality Air quality class from the MQ-5 level\n"
+               "# TYPE weatherstation_gas_quality gauge\n"
+               "weatherstation_gas_quality{quality=\"%s\"} 1\n", state.gasQuality);
+    writeMetric(out, "gas_alarm", "gauge", "1 while the gas alarm is raised", (uint32_t)state.gasAlarm);
+    out.printf("# HELP weatherstation_wifi_rssi_dbm Wi-Fi signal strength\n"
+               "# TYPE weatherstation_wifi_rssi_dbm gauge\n"
+               "weatherstation_wifi_rssi_dbm %d\n", (int)state.wifiRssi);
+
+    writeMetric(out, "uptime_seconds", "counter", "Seconds since boot", state.uptime);
+    writeMetric(out, "heap_free_bytes", "gauge", "Free heap", state.freeHeap);
+    writeMetric(out, "heap_min_free_bytes", "gauge", "Lowest free heap since boot", state.minFreeHeap);
+    writeMetric(out, "heap_max_alloc_bytes", "gauge", "Largest allocatable block", state.maxAllocHeap);
+    writeMetric(out, "heap_fragmentation_percent", "gauge", "Free heap outside the largest block",
+                state.fragmentation);
+    writeMetric(out, "heap_allocations_total", "counter", "Heap allocations by all tasks", state.allocations);
+    out.printf("# HELP weatherstation_heap_subsystem_allocations_total Heap allocations per subsystem\n"
+               "# TYPE weatherstation_heap_subsystem_allocations_total counter\n");
+    for (size_t i = 0; i < static_cast<size_t>(MemSubsystem::Count); i++) {
+        out.printf("weatherstation_heap_subsystem_allocations_total{subsystem=\"%s\"} %u\n",
+                   memSubsystemName(static_cast<MemSubsystem>(i)), (unsigned)state.subsystemAllocations[i]);
+    }
+    out.printf("# HELP weatherstation_heap_subsystem_allocated_bytes_total Bytes requested per subsystem\n"
+               "# TYPE weatherstation_heap_subsystem_allocated_bytes_total counter\n");
+    for (size_t i = 0; i < static_cast<size_t>(MemSubsystem::Count); i++) {
+        out.printf("weatherstation_heap_subsystem_allocated_bytes_total{subsystem=\"%s\"} %u\n",
+                   memSubsystemName(static_cast<MemSubsystem>(i)), (unsigned)state.subsystemBytes[i]);
+    }
+    out.printf("# HELP weatherstation_arena_capacity_bytes Size of a memory arena reserved at boot\n"
+               "# TYPE weatherstation_arena_capacity_bytes gauge\n");
+    for (uint8_t i = 0; i < state.arenaCount; i++) {
+        out.printf("weatherstation_arena_capacity_bytes{arena=\"%s\"} %u\n", state.arenas[i].name,
+                   (unsigned)state.arenas[i].capacity);
+    }
+    out.printf("# HELP weatherstation_arena_peak_bytes Most of a memory arena used at once since boot\n"
+               "# TYPE weatherstation_arena_peak_bytes gauge\n");
+    for (uint8_t i = 0; i < state.arenaCount; i++) {
+        out.printf("weatherstation_arena_peak_bytes{arena=\"%s\"} %u\n", state.arenas[i].name,
+                   (unsigned)state.arenas[i].peak);
+    }
+    out.printf("# HELP weatherstation_arena_failures_total Allocations a full memory arena refused\n"
+               "# TYPE weatherstation_arena_failures_total counter\n");
+    for (uint8_t i = 0; i < state.arenaCount; i++) {
+        out.printf("weatherstation_arena_failures_total{arena=\"%s\"} %u\n", state.arenas[i].name,
+                   (unsigned)state.arenas[i].failures);
+    }
+    writeMetric(out, "loop_iterations_total", "counter", "Passes of the main loop", state.loopCount);
+    writeMetric(out, "loop_average_seconds", "gauge", "Average loop pass over the last second",
+                state.loopAverage / 1e6f);
+    writeMetric(out, "loop_max_seconds", "gauge", "Longest loop pass over the last second",
+                state.loopMax / 1e6f);
+    writeMetric(out, "loop_allocations", "gauge", "Heap allocations by the main loop over the last second",
+                state.loopAllocations);
+    writeMetric(out, "loop_allocations_max", "gauge", "Most heap allocations in one loop pass over the last second",
+                state.loopAllocationsMax);
+
+    writeMetric(out, "mqtt_connected", "gauge", "1 while connected to the broker", (uint32_t)state.mqttConnected);
+    writeMetric(out, "mqtt_connects_total", "counter", "Successful broker connects", state.mqttConnects);
+    writeMetric(out, "mqtt_published_total", "counter", "Sensor values published", state.mqttPublished);
+    writeMetric(out, "mqtt_downgraded_total", "counter", "Sensor values sent at QoS 0 instead of QoS 1",
+                state.mqttDowngraded);
+    writeMetric(out, "mqtt_acknowledged_total", "counter", "QoS 1 messages acknowledged",
+                state.mqttAcknowledged);
+    writeMetric(out, "mqtt_retransmits_total", "counter", "QoS 1 retransmissions", state.mqttRetransmits);
+    writeMetric(out, "mqtt_queued_samples", "gauge", "Samples waiting in the offline queue", state.mqttQueued);
+    writeMetric(out, "mqtt_dropped_total", "counter", "Samples dropped by the offline queue", state.mqttDropped);
+
+    writeMetric(out, "weather_requests_total", "counter", "Weather API requests sent", state.weatherRequests);
+    writeMetric(out, "weather_reused_total", "counter", "Requests sent on a kept-alive connection",
+                state.weatherReused);
+    writeMetric(out, "weather_not_modified_total", "counter", "Requests answered 304 or skipped as fresh",
+                state.weatherNotModified);
+    writeMetric(out, "weather_failed_total", "counter", "Requests that failed", state.weatherFailed);
+    writeMetric(out, "weather_throttled_total", "counter", "Requests skipped by the call budget",
+                state.weatherThrottled);
+    writeMetric(out, "weather_age_seconds", "gauge", "Seconds since the last successful weather fetch",
+                state.weatherAge == NO_WEATHER_DATA ? NAN : (float)state.weatherAge);
+    return out.length;
+}
+
+// Format a reading as a JSON number, or null if the sensor had no value
+static const char *jsonNumber(char *buffer, size_t size, float value) {
+    if (isnan(value)) {
+        return "null";
+    }
+    snprintf(buffer, size, "%.1f", value);
+    return buffer;
+}
+
+static size_t renderState(char *buffer, size_t capacity, const TelemetryState &state) {
+    char temperatureText[12];
+    char humidityText[12];
+    char mq5Text[12];
+    char weatherAgeText[12] = "null";
+    if (state.weatherAge != NO_WEATHER_DATA) {
+        snprintf(weatherAgeText, sizeof(weatherAgeText), "%u", (unsigned)state.weatherAge);
+    }
+
+    BufferWriter out = {buffer, capacity, 0};
+    buffer[0] = '\0';
+    out.printf("{\"uptime\":%u,"
+        "\"sensors\":{\"temperature\":%s,\"humidity\":%s,\"mq5\":%s,\"gas\":\"%s\",\"gas_alarm\":%s},"
+        "\"wifi\":{\"rssi\":%d},"
+        "\"heap\":{\"free\":%u,\"min_free\":%u,\"max_alloc\":%u,\"fragmentation\":%u,\"allocations\":%u,"
+        "\"subsystems\":{",
+        (unsigned)state.uptime,
+        jsonNumber(temperatureText, sizeof(temperatureText), state.temperature),
+        jsonNumber(humidityText, sizeof(humidityText), state.humidity),
+        jsonNumber(mq5Text, sizeof(mq5Text), state.mq5Percentage),
+        state.gasQuality, state.gasAlarm ? "true" : "false",
+        (int)state.wifiRssi,
+        (unsigned)state.freeHeap, (unsigned)state.minFreeHeap, (unsigned)state.maxAllocHeap,
+        (unsigned)state.fragmentation, (unsigned)state.allocations);
+    for (size_t i = 0; i < static_cast<size_t>(MemSubsystem::Count); i++) {
+        out.printf("%s\"%s\":{\"allocations\":%u,\"bytes\":%u}", i > 0 ? "," : "",
+                   memSubsystemName(static_cast<MemSubsystem>(i)), (unsigned)state.subsystemAllocations[i],
+                   (unsigned)state.subsystemBytes[i]);
+    }
+    out.printf("},\"arenas\":{");
+    for (uint8_t i = 0; i < state.arenaCount; i++) {
+        out.printf("%s\"%s\":{\"capacity\":%u,\"peak\":%u,\"failures\":%u}", i > 0 ? "," : "",
+                   state.arenas[i].name, (unsigned)state.arenas[i].capacity, (unsigned)state.arenas[i].peak,
+                   (unsigned)state.arenas[i].failures);
+    }
+    out.printf("}},"
+        "\"loop\":{\"count\":%u,\"avg_us\":%u,\"max_us\":%u,\"allocations\":%u,\"allocations_max\":%u},"
+        "\"mqtt\":{\"connected\":%s,\"connects\":%u,\"published\":%u,\"downgraded\":%u,\"acknowledged\":%u,"
+        "\"retransmits\":%u,\"queued\":%u,\"dropped\":%u},"
+        "\"weather\":{\"requests\":%u,\"reused\":%u,\"not_modified\":%u,\"failed\":%u,"
+        "\"throttled\":%u,\"age\":%s}}",
+        (unsigned)state.loopCount, (unsigned)state.loopAverage, (unsigned)state.loopMax,
+        (unsigned)state.loopAllocations, (unsigned)state.loopAllocationsMax,
+        state.mqttConnected ? "true" : "false", (unsigned)state.mqttConnects, (unsigned)state.mqttPublished,
+        (unsigned)state.mqttDowngraded, (unsigned)state.mqttAcknowledged, (unsigned)state.mqttRetransmits,
+        (unsigned)state.mqttQueued, (unsigned)state.mqttDropped,
+        (unsigned)state.weatherRequests, (unsigned)state.weatherReused, (unsigned)state.weatherNotModified,
+        (unsigned)state.weatherFailed, (unsigned)state.weatherThrottled, weatherAgeText);
+    return out.length;
+}
+
+TelemetryDocument metricsDocument = {
+    {metricsText[0], metricsText[1]}, TELEMETRY_METRICS_SIZE, {0, 0}, {0, 0}, {0, 0}, 0, renderMetrics};
+TelemetryDocument stateDocument = {
+    {stateText[0], stateText[1]}, TELEMETRY_STATE_SIZE, {0, 0}, {0, 0}, {0, 0}, 0, renderState};
+
+// Render the latest snapshot into the spare slot, unless the current render is up to date
+// or a response is still being sent from the spare slot
+static void refreshDocument(TelemetryDocument &document) {
+    xSemaphoreTake(telemetryMutex, portMAX_DELAY);
+    if (telemetryVersion == 0 || document.version[document.front] == telemetryVersion) {
+        xSemaphoreGive(telemetryMutex);
+        return;
+    }
+    uint8_t back = document.front ^ 1;
+    if (document.readers[back] > 0) {
+        xSemaphoreGive(telemetryMutex);
+        return;  // Serve the previous render for now
+    }
+    TelemetryState snapshot = telemetryState;
+    uint32_t version = telemetryVersion;
+    xSemaphoreGive(telemetryMutex);
+
+    document.length[back] = document.render(document.text[back], document.capacity, snapshot);
+    document.version[back] = version;
+    document.front = back;
+}
+
+static void serveDocument(AsyncWebServerRequest *request, TelemetryDocument &document, const char *contentType) {
+    refreshDocument(document);
+    if (document.version[document.front] == 0) {
+        request->send(503, "text/plain", "No data yet");
+        return;
+    }
+
+    uint8_t slot = document.front;
+    document.readers[slot]++;  // The response reads the slot lazily, keep it until the client is gone
+    request->onDisconnect([&document, slot]() {
+        document.readers[slot]--;
+    });
+    const char *text = document.text[slot];
+    size_t length = document.length[slot];
+    AsyncWebServerResponse *response = request->beginResponse(contentType, length,
+        [text, length](uint8_t *buffer, size_t maxLen, size_t index) -> size_t {
+            size_t chunk = min(maxLen, length - index);
+            memcpy(buffer, text + index, chunk);
+            return chunk;
+        });
+    response->addHeader("Cache-Control", "no-cache");
+    request->send(response);
+}
+
+// Allocation trace as JSON, oldest first. Debug builds only (MEM_TRACE), so a response stream is fine here.
+static void serveMemTrace(AsyncWebServerRequest *request) {
+    std::unique_ptr<MemTraceEntry[]> entries(new MemTraceEntry[MEM_TRACE_SIZE]);
+    size_t count = readMemTrace(entries.get(), MEM_TRACE_SIZE);  // Before the response allocates
+
+    AsyncResponseStream *response = request->beginResponseStream("application/json");
+    response->addHeader("Cache-Control", "no-cache");
+    response->printf("{\"now\":%u,\"entries\":[", (unsigned)millis());
+    for (size_t i = 0; i < count; i++) {
+        response->printf("%s{\"time\":%u,\"caller\":\"0x%08x\",\"size\":%u,\"subsystem\":\"%s\"}",
+                         i > 0 ? "," : "", (unsigned)entries[i].time, (unsigned)entries[i].caller,
+                         (unsigned)entries[i].size, memSubsystemName(entries[i].subsystem));
+    }
+    response->print("]}");
+    request->send(response);
+}
+
+void setupTelemetry(AsyncWebServer &server) {
+    telemetryMutex = xSemaphoreCreateMutex();
+
+    server.on("/metrics", HTTP_GET, [](AsyncWebServerRequest *request) {
+        serveDocument(request, metricsDocument, "text/plain; version=0.0.4");
+    });
+    server.on("/api/state", HTTP_GET, [](AsyncWebServerRequest *request) {
+        serveDocument(request, stateDocument, "application/json");
+    });
+    if (MEM_TRACE) {
+        server.on("/api/memory/trace", HTTP_GET, serveMemTrace);
+    }
+}
+
+void recordLoopPass(uint32_t elapsed, uint32_t allocations) {
+    loopCount++;
+    loopTimeSum += elapsed;
+    loopTimeSamples++;
+    loopTimeMax = max(loopTimeMax, elapsed);
+    loopAllocationSum += allocations;
+    loopAllocationMax = max(loopAllocationMax, allocations);
+}
+
+void updateTelemetry(float temperature, float humidity, float mq5Percentage, const char *gasQuality,
+                     bool gasAlarm, int wifiSignalStrength) {
+    if (telemetryMutex == nullptr || millis() - lastTelemetrySample < TELEMETRY_SAMPLE_INTERVAL) {
+        return;
+    }
+    lastTelemetrySample = millis();
+
+    TelemetryState next;
+    memset(&next, 0, sizeof(next));  // Padding too, for the comparison below
+    next.temperature = temperature;
+    next.humidity = humidity;
+    next.mq5Percentage = mq5Percentage;
+    strlcpy(next.gasQuality, gasQuality, sizeof(next.gasQuality));
+    next.gasAlarm = gasAlarm;
+    next.wifiRssi = wifiSignalStrength;
+    next.uptime = millis() / 1000;
+    MemSnapshot memory;
+    readMemSnapshot(memory);
+    next.freeHeap = memory.freeHeap;
+    next.minFreeHeap = memory.minFreeHeap;
+    next.maxAllocHeap = memory.largestBlock;
+    next.fragmentation = memory.fragmentation;
+    next.allocations = allocationCount();
+    memcpy(next.subsystemAllocations, memory.allocations, sizeof(next.subsystemAllocations));
+    memcpy(next.subsystemBytes, memory.bytes, sizeof(next.subsystemBytes));
+    for (MemArena *arena = MemArena::first(); arena != nullptr && next.arenaCount < TELEMETRY_ARENA_SLOTS;
+         arena = arena->next()) {
+        next.arenas[next.arenaCount].name = arena->name();
+        next.arenas[next.arenaCount].capacity = arena->capacity();
+        next.arenas[next.arenaCount].peak = arena->peak();
+        next.arenas[next.arenaCount].failures = arena->failures();
+        next.arenaCount++;
+    }
+
+    next.loopCount = loopCount;
+    next.loopAverage = loopTimeSamples > 0 ? loopTimeSum / loopTimeSamples : 0;
+    next.loopMax = loopTimeMax;
+    next.loopAllocations = loopAllocationSum;
+    next.loopAllocationsMax = loopAllocationMax;
+    loopTimeSum = 0;
+    loopTimeSamples = 0;
+    loopTimeMax = 0;
+    loopAllocationSum = 0;
+    loopAllocationMax = 0;
+
+    MQTTStats mqtt = getMQTTStats();
+    next.mqttConnected = mqtt.connected;
+    next.mqttConnects = mqtt.connects;
+    next.mqttPublished = mqtt.published;
+    next.mqttDowngraded = mqtt.downgraded;
+    next.mqttAcknowledged = mqtt.acknowledged;
+    next.mqttRetransmits = mqtt.retransmits;
+    next.mqttQueued = mqtt.queued;
+    next.mqttDropped = mqtt.dropped;
+
+    next.weatherRequests = weatherHttp.requestCount();
+    next.weatherReused = weatherHttp.reusedCount();
+    next.weatherNotModified = weatherHttp.notModifiedCount();
+    next.weatherFailed = weatherHttp.failedCount();
+    next.weatherThrottled = weatherHttp.throttledCount();
+    unsigned long weatherAge = weatherPage.dataAge();
+    next.weatherAge = weatherAge == ULONG_MAX ? NO_WEATHER_DATA : weatherAge / 1000;
+
+    xSemaphoreTake(telemetryMutex, portMAX_DELAY);
+    if (memcmp(&next, &telemetryState, TELEMETRY_COMPARED_SIZE) != 0) {
+        telemetryVersion++;
+    }
+    memcpy(&telemetryState, &next, sizeof(next));  // Uptime and loop stats go out with the next render
+    xSemaphoreGive(telemetryMutex);
+}
@@ -0,0 +1,51 @@
+#include "WeatherBenchmark.h"
+#include "WeatherPage.h"
+
+// Scenarios served by tools/owm_standin.py, selected by the city name
+struct BenchmarkScenario {
+    const char *city;
+    bool expectSuccess;
+};
+
+const BenchmarkScenario benchmarkScenarios[] = {
+    {"ok", true},          // Full parse first, 304 afterwards
+    {"slow", true},
+    {"truncated", false},
+    {"oversized", true},   // Padding must be skipped by the filter
+    {"malformed", false},
+    {"chunked", false}     // Rejected, the body can't be parsed off the socket
+};
+
+void runWeatherBenchmark(Adafruit_ST7789 &tft, WeatherHttpSession &session) {
+    Serial.printf("Weather benchmark against %s:%u\n", WEATHER_API_HOST, WEATHER_API_PORT);
+    Serial.println("scenario,round,result,expected,total_us,parse_us,arena_peak,heap_drop,min_heap_drop");
+
+    unsigned unexpected = 0;
+    for (const BenchmarkScenario &scenario : benchmarkScenarios) {
+        WeatherPage page(tft, session, "bench", scenario.city);
+        page.setup();
+
+        for (int round = 0; round < WEATHER_BENCHMARK_ROUNDS; round++) {
+            uint32_t heapBefore = ESP.getFreeHeap();
+            uint32_t minHeapBefore = ESP.getMinFreeHeap();
+            unsigned long start = micros();
+
+            bool ok = page.refresh();
+
+            unsigned long total = micros() - start;
+            int32_t heapDrop = (int32_t)heapBefore - (int32_t)ESP.getFreeHeap();
+            int32_t minHeapDrop = (int32_t)minHeapBefore - (int32_t)ESP.getMinFreeHeap();
+            if (ok != scenario.expectSuccess) {
+                unexpected++;
+            }
+
+            Serial.printf("%s,%d,%s,%s,%lu,%lu,%u,%d,%d\n", scenario.city, round, ok ? "ok" : "fail",
+                          scenario.expectSuccess ? "ok" : "fail", total, page.getLastParseTime(),
+                          (unsigned)session.arena().peak(), (int)heapDrop, (int)minHeapDrop);
+        }
+    }
+
+    Serial.printf("Weather benchmark done: %u unexpected results, %u requests, %u on reused connections, %u not modified\n",
+                  unexpected, (unsigned)session.requestCount(), (unsigned)session.reusedCount(),
+                  (unsigned)session.notModifiedCount());
+}
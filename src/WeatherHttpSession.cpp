@@ -0,0 +1,400 @@
+#include "WeatherHttpSession.h"
+#include <lwip/sockets.h>
+#include <new>
+#include <stdarg.h>
+
+HttpBodyStream::HttpBodyStream() : source(nullptr), left(0) {}
+
+void HttpBodyStream::attach(Stream *stream, int length) {
+    source = stream;
+    left = length;
+}
+
+int HttpBodyStream::remaining() const {
+    return left;
+}
+
+int HttpBodyStream::available() {
+    if (!source || left == 0) {
+        return 0;
+    }
+    int count = source->available();
+    return left > 0 && count > left ? left : count;
+}
+
+int HttpBodyStream::read() {
+    if (!source || left == 0) {
+        return -1;
+    }
+    int c = source->read();
+    if (c >= 0 && left > 0) {
+        left--;
+    }
+    return c;
+}
+
+int HttpBodyStream::peek() {
+    if (!source || left == 0) {
+        return -1;
+    }
+    return source->peek();
+}
+
+size_t HttpBodyStream::readBytes(char *buffer, size_t length) {
+    if (!source || left == 0) {
+        return 0;
+    }
+    if (left > 0 && length > (size_t)left) {
+        length = left;
+    }
+    size_t count = source->readBytes(buffer, length);
+    if (left > 0) {
+        left -= count;
+    }
+    return count;
+}
+
+size_t HttpBodyStream::write(uint8_t) {
+    return 0;
+}
+
+WeatherHttpSession::WeatherHttpSession(const char *host, uint16_t port)
+    : host(host), port(port), active(false), keepAlive(false),
+      transactionArena("weather", arenaBuffer, sizeof(arenaBuffer)), requests(0), reused(0),
+      notModified(0), failed(0), throttled(0), budget(WEATHER_API_BURST), budgetRefilledAt(0) {}
+
+HttpFetchResult WeatherHttpSession::get(const char *path, HttpCacheEntry &cache) {
+    active = false;
+    transactionArena.reset();
+
+    // The server said the last response stays valid for a while, skip the radio entirely
+    if (cache.maxAge > 0 && millis() - cache.fetchedAt < cache.maxAge) {
+        notModified++;
+        return HttpFetchResult::Fresh;
+    }
+
+    if (WiFi.status() != WL_CONNECTED) {
+        Serial.println("WiFi not connected!");
+        failed++;
+        return HttpFetchResult::Failed;
+    }
+
+    if (!hasBudget()) {
+        Serial.println("Weather API budget used up, request skipped");
+        throttled++;
+        return HttpFetchResult::Throttled;
+    }
+    budget--;
+    requests++;
+
+    bool reusing = client.connected();
+    if (!reusing && !client.connect(host, port, WEATHER_HTTP_TIMEOUT)) {
+        Serial.println("Weather API connection failed");
+        failed++;
+        return HttpFetchResult::Failed;
+    }
+    // WiFiClient::setTimeout() takes seconds on older cores; readResponse() goes by the Stream timeout
+    static_cast<Stream &>(client).setTimeout(WEATHER_HTTP_TIMEOUT);
+    active = true;
+
+    // Headers are collected apart from the cache, an error response must not touch it
+    // Trivially destructible, so the arena reset needs no destructor call
+    void *memory = transactionArena.allocate(sizeof(HttpCacheEntry));
+    HttpCacheEntry *received = memory != nullptr ? new (memory) HttpCacheEntry : nullptr;
+    int contentLength = -1;
+    int httpCode = received != nullptr ? exchange(path, cache, *received, contentLength) : 0;
+    if (httpCode < 0 && reusing) {
+        // connected() does not notice a FIN, so the server may have closed the idle connection
+        // long ago. Retry once on a fresh one, on the budget token already taken.
+        client.stop();
+        reusing = false;
+        if (client.connect(host, port, WEATHER_HTTP_TIMEOUT)) {
+            static_cast<Stream &>(client).setTimeout(WEATHER_HTTP_TIMEOUT);
+            httpCode = exchange(path, cache, *received, contentLength);
+        }
+    }
+    if (reusing) {
+        reused++;
+    }
+
+    HttpFetchResult result;
+    if (httpCode == 304) {
+        bodyStream.attach(&client, 0);
+        storeValidators(cache, *received);
+        notModified++;
+        result = HttpFetchResult::NotModified;
+    } else if (httpCode == 200) {
+        bodyStream.attach(&client, contentLength);
+        storeValidators(cache, *received);
+        result = HttpFetchResult::Ok;
+    } else {
+        Serial.printf("Error in HTTP request: %d\n", httpCode);
+        bodyStream.attach(nullptr, 0);
+        client.stop();  // State of the connection is unknown, start over next time
+        failed++;
+        result = HttpFetchResult::Failed;
+    }
+
+    transactionArena.reset();  // Left empty for the body parser
+    return result;
+}
+
+static void appendRequest(char *request, size_t size, size_t &length, const char *format, ...)
+    __attribute__((format(printf, 4, 5)));
+
+static void appendRequest(char *request, size_t size, size_t &length, const char *format, ...) {
+    if (length >= size) {
+        return;
+    }
+    va_list args;
+    va_start(args, format);
+    int written = vsnprintf(request + length, size - length, format, args);
+    va_end(args);
+    length = written < 0 ? size : length + written;
+}
+
+// Sends the request and reads the response headers. Returns the status code, 0 if the response
+// was unusable, -1 if the connection turned out to be closed before any response arrived.
+int WeatherHttpSession::exchange(const char *path, const HttpCacheEntry &cache, HttpCacheEntry &received,
+                                 int &contentLength) {
+    received.clear();
+    contentLength = -1;
+    if (!sendRequest(path, cache)) {
+        return -1;
+    }
+
+    size_t mark = transactionArena.mark();
+    int httpCode = readResponse(received, contentLength);
+    transactionArena.rewind(mark);
+    return httpCode;
+}
+
+bool WeatherHttpSession::sendRequest(const char *path, const HttpCacheEntry &cache) {
+    size_t mark = transactionArena.mark();
+    char *request = static_cast<char *>(transactionArena.allocate(WEATHER_HTTP_REQUEST_SIZE));
+    if (request == nullptr) {
+        return false;
+    }
+
+    // HTTP/1.0 rules out chunked encoding, so the body can be parsed straight off the socket
+    size_t length = 0;
+    appendRequest(request, WEATHER_HTTP_REQUEST_SIZE, length, "GET %s HTTP/1.0\r\nHost: %s", path, host);
+    if (port != 80) {
+        appendRequest(request, WEATHER_HTTP_REQUEST_SIZE, length, ":%u", (unsigned)port);
+    }
+    appendRequest(request, WEATHER_HTTP_REQUEST_SIZE, length,
+                  "\r\nConnection: keep-alive\r\nUser-Agent: ESP32WeatherStation\r\n");
+    if (cache.etag[0] != '\0') {
+        appendRequest(request, WEATHER_HTTP_REQUEST_SIZE, length, "If-None-Match: %s\r\n", cache.etag);
+    }
+    if (cache.lastModified[0] != '\0') {
+        appendRequest(request, WEATHER_HTTP_REQUEST_SIZE, length, "If-Modified-Since: %s\r\n", cache.lastModified);
+    }
+    appendRequest(request, WEATHER_HTTP_REQUEST_SIZE, length, "\r\n");
+
+    bool sent = length < WEATHER_HTTP_REQUEST_SIZE &&
+                client.write(reinterpret_cast<const uint8_t *>(request), length) == length;
+    transactionArena.rewind(mark);
+    return sent;
+}
+
+// Reads the status line and headers up to the body. Returns the status code, 0 if the response was unusable,
+// -1 if the server closed the connection without sending anything.
+int WeatherHttpSession::readResponse(HttpCacheEntry &received, int &contentLength) {
+    char *line = static_cast<char *>(transactionArena.allocate(WEATHER_HTTP_LINE_SIZE));
+    if (line == nullptr) {
+        return 0;
+    }
+
+    // "HTTP/1.1 200 OK". The request is HTTP/1.0, so whatever version the server answers with,
+    // the connection closes unless the response says "Connection: keep-alive".
+    int length = readLine(line, WEATHER_HTTP_LINE_SIZE);
+    if (length == WEATHER_HTTP_CLOSED && line[0] == '\0') {
+        return -1;
+    }
+    const char *code = length > 0 ? strchr(line, ' ') : nullptr;
+    if (strncmp(line, "HTTP/1.", 7) != 0 || code == nullptr) {
+        return 0;
+    }
+    int httpCode = atoi(code + 1);
+    keepAlive = false;
+    bool chunked = false;
+
+    while ((length = readLine(line, WEATHER_HTTP_LINE_SIZE)) > 0) {
+        char *value = strchr(line, ':');
+        if (value == nullptr) {
+            continue;
+        }
+        *value++ = '\0';
+        while (*value == ' ') {
+            value++;
+        }
+
+        if (strcasecmp(line, "Content-Length") == 0) {
+            contentLength = atoi(value);
+        } else if (strcasecmp(line, "ETag") == 0) {
+            strlcpy(received.etag, value, sizeof(received.etag));
+        } else if (strcasecmp(line, "Last-Modified") == 0) {
+            strlcpy(received.lastModified, value, sizeof(received.lastModified));
+        } else if (strcasecmp(line, "Cache-Control") == 0) {
+            const char *maxAge = strstr(value, "max-age=");
+            if (maxAge != nullptr && strstr(value, "no-cache") == nullptr && strstr(value, "no-store") == nullptr) {
+                received.maxAge = strtoul(maxAge + 8, nullptr, 10) * 1000UL;
+            }
+        } else if (strcasecmp(line, "Connection") == 0) {
+            keepAlive = strcasecmp(value, "keep-alive") == 0;
+        } else if (strcasecmp(line, "Transfer-Encoding") == 0) {
+            chunked = strcasecmp(value, "identity") != 0;
+        }
+    }
+
+    if (length < 0) {
+        return 0;  // Timed out or closed before the end of the headers
+    }
+    if (chunked) {
+        // Not allowed in an answer to HTTP/1.0, and the body parser reads straight off the socket
+        Serial.println("Weather API sent a chunked body, rejected");
+        return 0;
+    }
+    return httpCode;
+}
+
+// One line without its line ending, cut to size. Returns its length, -1 on timeout
+// or WEATHER_HTTP_CLOSED once the server has closed the connection.
+int WeatherHttpSession::readLine(char *line, size_t size) {
+    size_t length = 0;
+    unsigned long start = millis();
+    bool readable = false;  // select() reported data since the last successful read
+    while (true) {
+        int c = client.read();
+        if (c < 0) {
+            if (readable) {
+                // Readable yet nothing to read: that was the server's FIN
+                line[length] = '\0';
+                return WEATHER_HTTP_CLOSED;
+            }
+            unsigned long elapsed = millis() - start;
+            if (elapsed >= WEATHER_HTTP_TIMEOUT || !waitForData(WEATHER_HTTP_TIMEOUT - elapsed)) {
+                break;
+            }
+            readable = true;
+            continue;
+        }
+        readable = false;
+        if (c == '\n') {
+            if (length > 0 && line[length - 1] == '\r') {
+                length--;
+            }
+            line[length] = '\0';
+            return length;
+        }
+        if (length < size - 1) {
+            line[length++] = c;
+        }
+    }
+    line[length] = '\0';
+    return -1;
+}
+
+// Blocks in select() until the socket is readable, so the task sleeps instead of polling.
+// Readable includes end of stream, which the next read() reports as -1. Returns false on timeout.
+bool WeatherHttpSession::waitForData(unsigned long timeout) {
+    if (client.available() > 0) {
+        return true;  // Already in the client's receive buffer
+    }
+    int fd = client.fd();
+    if (fd < 0) {
+        return false;
+    }
+
+    fd_set readable;
+    FD_ZERO(&readable);
+    FD_SET(fd, &readable);
+    struct timeval wait = {(time_t)(timeout / 1000), (suseconds_t)(timeout % 1000) * 1000};
+    return select(fd + 1, &readable, nullptr, nullptr, &wait) > 0;
+}
+
+Stream &WeatherHttpSession::body() {
+    return bodyStream;
+}
+
+MemArena &WeatherHttpSession::arena() {
+    return transactionArena;
+}
+
+void WeatherHttpSession::end() {
+    transactionArena.reset();
+    if (!active) {
+        return;
+    }
+    active = false;
+
+    // Whatever the parser skipped has to leave the socket before the next request
+    if (bodyStream.remaining() > 0) {
+        char scratch[64];
+        while (bodyStream.remaining() > 0) {
+            size_t chunk = min((size_t)bodyStream.remaining(), sizeof(scratch));
+            if (bodyStream.readBytes(scratch, chunk) == 0) {
+                break;
+            }
+        }
+    }
+
+    if (bodyStream.remaining() != 0 || !keepAlive) {
+        client.stop();  // Length unknown, body cut short or the server closes, the connection cannot be reused
+    }
+    bodyStream.attach(nullptr, 0);
+}
+
+void WeatherHttpSession::storeValidators(HttpCacheEntry &cache, const HttpCacheEntry &received) {
+    cache.fetchedAt = millis();
+    cache.maxAge = received.maxAge;
+
+    // A 304 may omit validators, in which case the stored ones stay valid
+    if (received.etag[0] != '\0') {
+        strlcpy(cache.etag, received.etag, sizeof(cache.etag));
+    }
+    if (received.lastModified[0] != '\0') {
+        strlcpy(cache.lastModified, received.lastModified, sizeof(cache.lastModified));
+    }
+}
+
+bool WeatherHttpSession::hasBudget() {
+    refillBudget();
+    return budget > 0;
+}
+
+void WeatherHttpSession::refillBudget() {
+    const unsigned long refillInterval = 3600000UL / WEATHER_API_CALLS_PER_HOUR;
+    unsigned long now = millis();
+
+    if (budget >= WEATHER_API_BURST) {
+        budgetRefilledAt = now;  // A full bucket does not bank time
+        return;
+    }
+    unsigned long earned = (now - budgetRefilledAt) / refillInterval;
+    if (earned > 0) {
+        budget = min<unsigned long>(WEATHER_API_BURST, budget + earned);
+        budgetRefilledAt += earned * refillInterval;
+    }
+}
+
+uint32_t WeatherHttpSession::requestCount() const {
+    return requests;
+}
+
+uint32_t WeatherHttpSession::reusedCount() const {
+    return reused;
+}
+
+uint32_t WeatherHttpSession::notModifiedCount() const {
+    return notModified;
+}
+
+uint32_t WeatherHttpSession::failedCount() const {
+    return failed;
+}
+
+uint32_t WeatherHttpSession::throttledCount() const {
+    return throttled;
+}
@@ -0,0 +1,46 @@
+#include "WeatherIcons.h"
+
+#include "../icons/clouds_broken.h"
+#include "../icons/clouds_few.h"
+#include "../icons/clouds_scattered.h"
+#include "../icons/mist.h"
+#include "../icons/moon.h"
+#include "../icons/rainy.h"
+#include "../icons/snowflake.h"
+#include "../icons/sun.h"
+#include "../icons/thunderstorm.h"
+
+// Icon for a condition ID, only evaluated at compile time to fill the table below
+static constexpr const uint16_t *iconForCondition(int id, bool night) {
+    if (id < 300) return thunderstorm;                    // 2xx Thunderstorm
+    if (id < 400) return rainy;                           // 3xx Drizzle
+    if (id == 511) return snowflake;                      // Freezing rain
+    if (id < 600) return rainy;                           // 5xx Rain
+    if (id < 700) return snowflake;                       // 6xx Snow and sleet
+    if (id == 781) return thunderstorm;                   // Tornado
+    if (id < 800) return mist;                            // 7xx Mist, smoke, haze, dust, fog, sand, ash, squalls
+    if (id == 800) return night ? moon : sun;             // Clear sky
+    if (id == 801) return clouds_few;                     // Few clouds
+    if (id == 802) return clouds_scattered;               // Scattered clouds
+    if (id == 803) return clouds_broken;                  // Broken clouds
+    return clouds_scattered;                              // 804 Overcast clouds
+}
+
+static constexpr std::array<ConditionIcons, CONDITION_ID_MAX - CONDITION_ID_MIN + 1> buildConditionIconTable() {
+    std::array<ConditionIcons, CONDITION_ID_MAX - CONDITION_ID_MIN + 1> table{};
+    for (int id = CONDITION_ID_MIN; id <= CONDITION_ID_MAX; id++) {
+        table[id - CONDITION_ID_MIN] = {iconForCondition(id, false), iconForCondition(id, true)};
+    }
+    return table;
+}
+
+extern constexpr std::array<ConditionIcons, CONDITION_ID_MAX - CONDITION_ID_MIN + 1> conditionIconTable =
+    buildConditionIconTable();
+
+const uint16_t *getConditionIcon(uint16_t conditionId, bool night) {
+    if (conditionId < CONDITION_ID_MIN || conditionId > CONDITION_ID_MAX) {
+        return sun;  // Default icon
+    }
+    const ConditionIcons &icons = conditionIconTable[conditionId - CONDITION_ID_MIN];
+    return night ? icons.night : icons.day;
+}
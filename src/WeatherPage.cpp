@@ -1,83 +1,259 @@
 #include "WeatherPage.h"
+#include <Preferences.h>
+#include <time.h>
+#include <rom/crc.h>
 
-// OpenWeatherMap API endpoint
-const char *apiEndpoint = "http://api.openweathermap.org/data/2.5/weather?q=";
+// OpenWeatherMap current weather path
+const char *weatherPathFormat = "/data/2.5/weather?q=%s&appid=%s&units=metric";
 
-WeatherPage::WeatherPage(Adafruit_ST7789 &display, const char *apiKey, const char *city)
-    : tft(display), apiKey(apiKey), city(city), temperature(0), feelsLike(0), humidity(0), lastUpdateTime(0) {}
+// Survives software resets and OTA restarts, validated by magic and CRC
+RTC_NOINIT_ATTR WeatherSnapshot rtcWeatherSnapshot;
+
+static uint32_t snapshotCrc(const WeatherSnapshot &snapshot) {
+    return crc32_le(0, (const uint8_t *)&snapshot, offsetof(WeatherSnapshot, crc));
+}
+
+static bool snapshotValid(const WeatherSnapshot &snapshot) {
+    return snapshot.magic == WEATHER_SNAPSHOT_MAGIC && snapshot.version == WEATHER_SNAPSHOT_VERSION &&
+           snapshot.crc == snapshotCrc(snapshot);
+}
+
+// Wall clock in epoch seconds, or 0 while NTP has not set it yet
+static uint32_t currentEpoch() {
+    time_t now = time(nullptr);
+    return now > 1600000000 ? now : 0;
+}
+
+// lastUpdateTime for data that is ageSeconds old. Compared in seconds, since the age in
+// milliseconds would overflow for snapshots older than ~49 days.
+static unsigned long lastUpdateForAge(uint32_t ageSeconds, unsigned long updateInterval) {
+    if (ageSeconds >= updateInterval / 1000) {
+        return millis() - updateInterval;  // Due for a refresh
+    }
+    return millis() - ageSeconds * 1000UL;
+}
+
+WeatherPage::WeatherPage(Adafruit_ST7789 &display, WeatherHttpSession &session, const char *apiKey, const char *city)
+    : tft(display), session(session), apiKey(apiKey), city(city), weatherDescription(""), conditionId(0), isNight(false), timezoneOffset(0), temperature(0), feelsLike(0), humidity(0), lastUpdateTime(0), fetchedAt(0), snapshotSavedAt(0), hasData(false), changed(false), lastParseTime(0) {
+    path[0] = '\0';
+    cache.clear();
+}
 
 void WeatherPage::setup() {
-    getWeather();  // Fetch initial weather data
+    // Everything else in the response is skipped while parsing
+    filter["weather"][0]["id"] = true;
+    filter["weather"][0]["icon"] = true;
+    filter["weather"][0]["description"] = true;
+    filter["main"]["temp"] = true;
+    filter["main"]["feels_like"] = true;
+    filter["main"]["humidity"] = true;
+    filter["timezone"] = true;
+
+    snprintf(path, sizeof(path), weatherPathFormat, city, apiKey);
+
+    if (!restoreSnapshot()) {
+        refresh();  // Nothing to show yet, fetch initial weather data
+        return;
+    }
+    hasData = true;
+
+    // Show the restored data right away and only refresh once it is due
+    uint32_t now = currentEpoch();
+    if (fetchedAt > 0 && now >= fetchedAt) {
+        lastUpdateTime = lastUpdateForAge(now - fetchedAt, updateInterval);
+    } else {
+        lastUpdateTime = millis() - updateInterval;  // Stale or age unknown, due for a refresh
+    }
 }
 
-void WeatherPage::update(bool forceRender) {
-    unsigned long currentTime = millis();
+int32_t WeatherPage::getTimezoneOffset() const {
+    return timezoneOffset;
+}
 
-    // Update weather data if the interval has passed
-    if (currentTime - lastUpdateTime >= updateInterval) {
-        float oldTemperature = temperature;  // Store previous values for comparison
-        float oldFeelsLike = feelsLike;
-        float oldHumidity = humidity;
+unsigned long WeatherPage::dataAge() const {
+    return hasData ? millis() - lastUpdateTime : ULONG_MAX;
+}
 
-        getWeather();  // Fetch new weather data
-        lastUpdateTime = currentTime;  // Update the last update time
+unsigned long WeatherPage::refreshInterval() const {
+    return updateInterval;
+}
 
-        // Only display if any weather value has changed
-        if (temperature != oldTemperature || feelsLike != oldFeelsLike || humidity != oldHumidity) {
-            displayWeather();
-        }
+unsigned long WeatherPage::getLastParseTime() const {
+    return lastParseTime;
+}
+
+// Called by WeatherRefreshPolicy; drawing is left to update()
+bool WeatherPage::refresh() {
+    float oldTemperature = temperature;  // Store previous values for comparison
+    float oldFeelsLike = feelsLike;
+    float oldHumidity = humidity;
+    uint16_t oldConditionId = conditionId;
+    bool oldIsNight = isNight;
+    char oldDescription[WEATHER_DESCRIPTION_LENGTH];
+    strlcpy(oldDescription, weatherDescription, sizeof(oldDescription));
+
+    if (!getWeather()) {
+        return false;
     }
+    lastUpdateTime = millis();
+    hasData = true;
 
-    // Force render if requested
-    if (forceRender) {
+    // Only redraw if any weather value has changed
+    if (temperature != oldTemperature || feelsLike != oldFeelsLike || humidity != oldHumidity ||
+        conditionId != oldConditionId || isNight != oldIsNight || strcmp(weatherDescription, oldDescription) != 0) {
+        changed = true;
+    }
+    return true;
+}
+
+void WeatherPage::update(bool forceRender) {
+    if (forceRender || changed) {
         displayWeather();
+        changed = false;
     }
 }
 
-void WeatherPage::getWeather() {
-    if (WiFi.status() == WL_CONNECTED) {
-        HTTPClient http;
+bool WeatherPage::getWeather() {
+    bool ok = false;
+    HttpFetchResult result = session.get(path, cache);
+    if (result == HttpFetchResult::NotModified || result == HttpFetchResult::Fresh) {
+        session.end();
+        fetchedAt = currentEpoch();  // Data confirmed current
+        saveSnapshot();
+        return hasData;  // Nothing changed since the last parse
+    }
 
-        String url = String(apiEndpoint) + city + "&appid=" + apiKey + "&units=metric";
-        Serial.println("Requesting URL: " + url);
-        
-        http.begin(url);
-        int httpCode = http.GET();
+    if (result == HttpFetchResult::Ok) {
+        unsigned long parseStart = micros();
 
-        if (httpCode > 0) {
-            String payload = http.getString();
-            Serial.println("Response:\n" + payload);
+        {
+            // Parsed into the session's arena instead of the heap
+            JsonArena arena(session.arena());
+            JsonDocument doc(&arena);
+            DeserializationError error = deserializeJson(doc, session.body(), DeserializationOption::Filter(filter));
+            lastParseTime = micros() - parseStart;
 
-            JsonDocument doc;
-            DeserializationError error = deserializeJson(doc, payload);
+            if (!error && !doc["main"]["temp"].is<float>()) {
+                error = DeserializationError::InvalidInput;  // Well-formed, but not a weather response
+            }
 
             if (!error) {
-                weatherDescription = doc["weather"][0]["description"].as<String>();
+                JsonObject condition = doc["weather"][0];
+                conditionId = condition["id"] | 0;
+                const char *iconCode = condition["icon"] | "";
+                isNight = strlen(iconCode) == 3 && iconCode[2] == 'n';
+                strlcpy(weatherDescription, condition["description"] | "", sizeof(weatherDescription));
                 temperature = doc["main"]["temp"];
                 feelsLike = doc["main"]["feels_like"];
                 humidity = doc["main"]["humidity"];
+                timezoneOffset = doc["timezone"] | timezoneOffset;
+                Serial.printf("Weather: %s, %.1f C (parsed in %lu us, %u bytes)\n", weatherDescription, temperature,
+                              lastParseTime, (unsigned)arena.peak());
+                fetchedAt = currentEpoch();
+                saveSnapshot();
+                ok = true;
             } else {
-                Serial.println("Failed to parse JSON!");
+                Serial.print("Failed to parse JSON: ");
+                Serial.println(error.c_str());
+                cache.clear();  // Don't let a 304 confirm data we never got
             }
-        } else {
-            Serial.println("Error in HTTP request: " + String(httpCode));
         }
+    }
 
-        http.end();
+    session.end();
+    return ok;
+}
+
+// Load the last weather state, preferring RTC memory (soft reset) over NVS (power cycle)
+bool WeatherPage::restoreSnapshot() {
+    WeatherSnapshot snapshot;
+    bool found = snapshotValid(rtcWeatherSnapshot);
+    if (found) {
+        snapshot = rtcWeatherSnapshot;
     } else {
-        Serial.println("WiFi not connected!");
+        Preferences prefs;
+        if (prefs.begin("weather", true)) {
+            found = prefs.getBytesLength("snapshot") == sizeof(WeatherSnapshot) &&
+                    prefs.getBytes("snapshot", &snapshot, sizeof(WeatherSnapshot)) == sizeof(WeatherSnapshot) &&
+                    snapshotValid(snapshot);
+            prefs.end();
+        }
+        if (found) {
+            snapshotSavedAt = snapshot.fetchedAt;
+        }
     }
+    if (!found) {
+        return false;
+    }
+
+    loadSnapshotValues(snapshot);
+    Serial.printf("Weather restored: %s, %.1f C, fetched at %u\n", weatherDescription, temperature, (unsigned)fetchedAt);
+    return true;
 }
 
-const uint16_t* WeatherPage::getWeatherIcon() {
-    // Find the corresponding icon for the weather description
-    for (const auto &mapping : weatherIcons) {
-        if (weatherDescription.indexOf(mapping.description) >= 0) {
-            return mapping.icon;  // Return matching icon
+void WeatherPage::loadSnapshotValues(const WeatherSnapshot &snapshot) {
+    conditionId = snapshot.conditionId;
+    isNight = snapshot.isNight;
+    timezoneOffset = snapshot.timezoneOffset;
+    temperature = snapshot.temperature;
+    feelsLike = snapshot.feelsLike;
+    humidity = snapshot.humidity;
+    strlcpy(weatherDescription, snapshot.description, sizeof(weatherDescription));
+    fetchedAt = snapshot.fetchedAt;
+}
+
+WeatherSnapshot WeatherPage::getSnapshot() const {
+    WeatherSnapshot snapshot = {};
+    snapshot.magic = WEATHER_SNAPSHOT_MAGIC;
+    snapshot.version = WEATHER_SNAPSHOT_VERSION;
+    snapshot.conditionId = conditionId;
+    snapshot.fetchedAt = fetchedAt;
+    snapshot.timezoneOffset = timezoneOffset;
+    snapshot.temperature = temperature;
+    snapshot.feelsLike = feelsLike;
+    snapshot.humidity = humidity;
+    snapshot.isNight = isNight;
+    strlcpy(snapshot.description, weatherDescription, sizeof(snapshot.description));
+    snapshot.crc = snapshotCrc(snapshot);
+    return snapshot;
+}
+
+// Take over weather fetched by another station. Ignored unless newer than what we have.
+bool WeatherPage::applySnapshot(const WeatherSnapshot &snapshot) {
+    uint32_t now = currentEpoch();
+    if (snapshot.fetchedAt == 0 || now < snapshot.fetchedAt || (hasData && snapshot.fetchedAt <= fetchedAt)) {
+        return false;
+    }
+
+    loadSnapshotValues(snapshot);
+    lastUpdateTime = lastUpdateForAge(now - fetchedAt, updateInterval);
+    hasData = true;
+    changed = true;
+    saveSnapshot();
+    return true;
+}
+
+// RTC copy on every fetch, NVS copy at most every WEATHER_SNAPSHOT_NVS_INTERVAL.
+// Without NTP the interval can't be measured, so flash is only written once the clock is set.
+void WeatherPage::saveSnapshot() {
+    WeatherSnapshot snapshot = getSnapshot();
+    rtcWeatherSnapshot = snapshot;
+
+    if (fetchedAt == 0) {
+        return;
+    }
+    if (snapshotSavedAt == 0 || fetchedAt - snapshotSavedAt >= WEATHER_SNAPSHOT_NVS_INTERVAL) {
+        Preferences prefs;
+        if (prefs.begin("weather", false)) {
+            prefs.putBytes("snapshot", &snapshot, sizeof(WeatherSnapshot));
+            prefs.end();
+            snapshotSavedAt = fetchedAt;
         }
     }
+}
 
-    return sun;  // Default icon
+const uint16_t* WeatherPage::getWeatherIcon() {
+    return getConditionIcon(conditionId, isNight);
 }
 
 void WeatherPage::displayWeather() {
@@ -0,0 +1,66 @@
+#include "WeatherRefreshPolicy.h"
+#include "WeatherShare.h"
+#include "MemStats.h"
+
+WeatherRefreshPolicy::WeatherRefreshPolicy(WeatherPage &weather, ForecastPage &forecast, WeatherHttpSession &session)
+    : weather(weather), forecast(forecast), session(session), lastWeatherAttempt(0), lastForecastAttempt(0),
+      weatherFailed(false), forecastFailed(false) {}
+
+void WeatherRefreshPolicy::loop(ScreenState screen, unsigned long weatherDueIn, unsigned long forecastDueIn) {
+    MemScope memScope(MemSubsystem::Weather);
+    ScreenState weatherScreen = screen;
+    if (WEATHER_SHARE) {
+        WeatherSnapshot shared;
+        if (takeSharedWeather(shared)) {
+            weather.applySnapshot(shared);
+        }
+
+        if (!weatherShareShouldFetch()) {
+            weatherDueIn = WEATHER_NOT_SCHEDULED;  // Another station fetches for us
+        } else {
+            // Other stations may be showing what we fetch, keep it fresh regardless of our own screen
+            weatherScreen = ScreenState::On;
+            weatherDueIn = 0;
+        }
+    }
+
+    if (!session.hasBudget()) {
+        return;
+    }
+
+    bool weatherNeeded = needsRefresh(weatherScreen, weatherDueIn, weather.dataAge(), weather.refreshInterval(),
+                                      weatherFailed, lastWeatherAttempt);
+    bool forecastNeeded = needsRefresh(screen, forecastDueIn, forecast.dataAge(), forecast.refreshInterval(),
+                                       forecastFailed, lastForecastAttempt);
+
+    // At most one fetch per pass, the page due first goes first
+    if (weatherNeeded && (!forecastNeeded || weatherDueIn <= forecastDueIn)) {
+        lastWeatherAttempt = millis();
+        weatherFailed = !weather.refresh();
+        if (WEATHER_SHARE && !weatherFailed) {
+            shareWeatherSnapshot(weather.getSnapshot());
+        }
+    } else if (forecastNeeded) {
+        lastForecastAttempt = millis();
+        forecastFailed = !forecast.refresh();
+    }
+}
+
+bool WeatherRefreshPolicy::needsRefresh(ScreenState screen, unsigned long dueIn, unsigned long age, unsigned long interval,
+                                        bool failed, unsigned long lastAttempt) const {
+    // Nobody can see it, or it is not coming up soon
+    if (screen == ScreenState::Off || dueIn == WEATHER_NOT_SCHEDULED || dueIn > WEATHER_PREFETCH_LEAD) {
+        return false;
+    }
+    if (failed && millis() - lastAttempt < WEATHER_RETRY_INTERVAL) {
+        return false;
+    }
+    if (age == ULONG_MAX) {
+        return true;
+    }
+
+    // Refresh if the data would be stale by the time the page is shown. No separate rule for
+    // a dimmed screen: the slideshow (SLIDESHOW_DELAY) takes over before the backlight dims
+    // (DIM_DELAY), so the rotation never runs while dimmed.
+    return age + dueIn >= interval;
+}
@@ -0,0 +1,149 @@
+#include "WeatherShare.h"
+#include "DeviceIdentity.h"
+#include "MQTTHandler.h"
+#include "MQTTSession.h"
+#include "JsonArena.h"
+#include <ArduinoJson.h>
+#include <time.h>
+
+char weatherShareTopic[MQTT_MAX_TOPIC_LENGTH];
+
+// Last snapshot seen on the share topic, including our own
+char sharedSource[DEVICE_STRING_LENGTH] = "";
+uint32_t sharedFetchedAt = 0;
+
+WeatherSnapshot receivedSnapshot;
+bool snapshotReceived = false;
+
+unsigned long shareStartedAt = 0;
+uint32_t takeoverDelay = 0;  // Seconds, lower client IDs take over first
+
+// Seconds since epoch if the clock has been set via NTP, 0 otherwise
+static uint32_t shareEpoch() {
+    time_t now = time(nullptr);
+    return now > 1600000000 ? (uint32_t)now : 0;
+}
+
+void setupWeatherShare(const char *city) {
+    // Topic-safe city name: lower case, anything but letters and digits becomes '-'
+    char citySlug[32];
+    size_t length = 0;
+    for (const char *c = city; *c && length < sizeof(citySlug) - 1; c++) {
+        citySlug[length++] = isalnum((unsigned char)*c) ? tolower((unsigned char)*c) : '-';
+    }
+    citySlug[length] = '\0';
+    snprintf(weatherShareTopic, sizeof(weatherShareTopic), "%s/shared/weather/%s", MQTT_TOPIC_ROOT, citySlug);
+
+    // The client ID ends in the MAC suffix; spread it over the takeover window
+    const char *clientId = getMqttClientId();
+    size_t idLength = strlen(clientId);
+    uint32_t suffix = strtoul(clientId + (idLength > 6 ? idLength - 6 : 0), nullptr, 16);
+    takeoverDelay = (uint64_t)suffix * WEATHER_SHARE_TAKEOVER_SPREAD / 0x1000000;
+    shareStartedAt = millis();
+
+    Serial.printf("Weather share on %s (takeover after %u s)\n", weatherShareTopic, (unsigned)takeoverDelay);
+}
+
+const char *getWeatherShareTopic() {
+    return weatherShareTopic;
+}
+
+bool isWeatherShareLeader() {
+    return strcmp(sharedSource, getMqttClientId()) == 0;
+}
+
+void handleWeatherShareMessage(const uint8_t *payload, size_t length) {
+    JsonArena arena(getMqttArena());
+    JsonDocument doc(&arena);
+    if (length == 0 || deserializeJson(doc, payload, length)) {
+        return;  // Cleared or not ours
+    }
+
+    const char *source = doc["src"] | "";
+    uint32_t fetchedAt = doc["at"] | 0;
+    if (source[0] == '\0' || fetchedAt == 0) {
+        return;
+    }
+
+    // Our own publish coming back, or retained from before a reboot: we are still the leader
+    int order = strcmp(source, getMqttClientId());
+    if (order == 0) {
+        strlcpy(sharedSource, source, sizeof(sharedSource));
+        sharedFetchedAt = max(sharedFetchedAt, fetchedAt);
+        return;
+    }
+
+    // Two leaders: the lower client ID keeps the role, our next publish replaces theirs
+    if (isWeatherShareLeader()) {
+        if (order > 0) {
+            return;
+        }
+    } else if (fetchedAt <= sharedFetchedAt) {
+        return;
+    }
+
+    strlcpy(sharedSource, source, sizeof(sharedSource));
+    sharedFetchedAt = fetchedAt;
+
+    WeatherSnapshot snapshot = {};
+    snapshot.fetchedAt = fetchedAt;
+    snapshot.conditionId = doc["id"] | 0;
+    snapshot.isNight = (doc["n"] | 0) != 0;
+    snapshot.timezoneOffset = doc["tz"] | 0;
+    snapshot.temperature = doc["t"] | 0.0f;
+    snapshot.feelsLike = doc["f"] | 0.0f;
+    snapshot.humidity = doc["h"] | 0.0f;
+    strlcpy(snapshot.description, doc["d"] | "", sizeof(snapshot.description));
+    receivedSnapshot = snapshot;
+    snapshotReceived = true;
+
+    Serial.printf("Shared weather from %s: %s, %.1f C\n", source, snapshot.description, snapshot.temperature);
+}
+
+bool weatherShareShouldFetch() {
+    uint32_t now = shareEpoch();
+    if (now == 0 || isWeatherShareLeader()) {
+        return true;  // Without a clock the shared data cannot be aged, fetch as usual
+    }
+    if (sharedFetchedAt == 0) {
+        return (millis() - shareStartedAt) / 1000 >= WEATHER_SHARE_STARTUP_GRACE + takeoverDelay;
+    }
+    return now < sharedFetchedAt || now - sharedFetchedAt >= WEATHER_SHARE_STALE_AFTER + takeoverDelay;
+}
+
+bool takeSharedWeather(WeatherSnapshot &snapshot) {
+    if (!snapshotReceived) {
+        return false;
+    }
+    snapshot = receivedSnapshot;
+    snapshotReceived = false;
+    return true;
+}
+
+void shareWeatherSnapshot(const WeatherSnapshot &snapshot) {
+    if (snapshot.fetchedAt == 0) {
+        return;  // Others could not tell how old it is
+    }
+
+    JsonArena arena(getMqttArena());
+    JsonDocument doc(&arena);
+    doc["src"] = getMqttClientId();
+    doc["at"] = snapshot.fetchedAt;
+    doc["id"] = snapshot.conditionId;
+    doc["n"] = snapshot.isNight ? 1 : 0;
+    doc["tz"] = snapshot.timezoneOffset;
+    doc["t"] = snapshot.temperature;
+    doc["f"] = snapshot.feelsLike;
+    doc["h"] = snapshot.humidity;
+    doc["d"] = snapshot.description;
+
+    char payload[WEATHER_SHARE_PAYLOAD_LENGTH];
+    if (serializeJson(doc, payload, sizeof(payload)) >= sizeof(payload) - 1) {
+        return;  // Truncated
+    }
+
+    if (publishSharedWeather(weatherShareTopic, payload)) {
+        strlcpy(sharedSource, getMqttClientId(), sizeof(sharedSource));
+        sharedFetchedAt = snapshot.fetchedAt;
+    }
+}
@@ -0,0 +1,33 @@
+#include "WebAssets.h"
+#include "WebAssetsData.h"
+
+static void serveAsset(AsyncWebServerRequest *request, const WebAsset &asset) {
+    const AsyncWebHeader *ifNoneMatch = request->getHeader("If-None-Match");
+    if (ifNoneMatch != nullptr && ifNoneMatch->value().equals(asset.etag)) {
+        AsyncWebServerResponse *response = request->beginResponse(304);
+        response->addHeader("ETag", asset.etag);
+        request->send(response);
+        return;
+    }
+
+    // Read from flash as the response goes out, nothing is copied to the heap
+    AsyncWebServerResponse *response = request->beginResponse(200, asset.contentType, asset.data, asset.length);
+    response->addHeader("Content-Encoding", "gzip");
+    response->addHeader("ETag", asset.etag);
+    response->addHeader("Cache-Control", "no-cache");  // Always revalidate, a firmware update may change it
+    request->send(response);
+}
+
+void setupWebAssets(AsyncWebServer &server) {
+    for (size_t i = 0; i < webAssetCount; i++) {
+        const WebAsset &asset = webAssets[i];
+        server.on(asset.path, HTTP_GET, [&asset](AsyncWebServerRequest *request) {
+            serveAsset(request, asset);
+        });
+        if (strcmp(asset.path, "/index.html") == 0) {
+            server.on("/", HTTP_GET, [&asset](AsyncWebServerRequest *request) {
+                serveAsset(request, asset);
+            });
+        }
+    }
+}
@@ -0,0 +1,75 @@
+#include "WebDashboard.h"
+#include "MemStats.h"
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+
+extern String version;  // Firmware version string
+
+AsyncEventSource dashboardEvents("/events");
+
+// Last snapshot pushed, also sent to browsers as they connect
+char dashboardJson[DASHBOARD_BUFFER_SIZE] = "";
+uint32_t dashboardEventId = 0;
+unsigned long lastDashboardPush = 0;
+
+// The buffer is written by the loop task and read by the AsyncTCP task when a browser connects
+SemaphoreHandle_t dashboardMutex = nullptr;
+const TickType_t DASHBOARD_LOCK_TIMEOUT = pdMS_TO_TICKS(10);
+
+// Format a reading as a JSON number, or null if the sensor had no value
+static const char *jsonNumber(char *buffer, size_t size, float value) {
+    if (isnan(value)) {
+        return "null";
+    }
+    snprintf(buffer, size, "%.1f", value);
+    return buffer;
+}
+
+void setupWebDashboard(AsyncWebServer &server) {
+    dashboardMutex = xSemaphoreCreateMutex();
+
+    // New browsers get the last snapshot right away instead of waiting for a change
+    dashboardEvents.onConnect([](AsyncEventSourceClient *client) {
+        if (xSemaphoreTake(dashboardMutex, DASHBOARD_LOCK_TIMEOUT) != pdTRUE) {
+            return;  // The next change reaches this client anyway
+        }
+        if (dashboardJson[0] != '\0') {
+            client->send(dashboardJson, "sensors", dashboardEventId);
+        }
+        xSemaphoreGive(dashboardMutex);
+    });
+    server.addHandler(&dashboardEvents);
+}
+
+void updateDashboard(float temperature, float humidity, float mq5Percentage, const char *gasQuality,
+                     int wifiSignalStrength, uint32_t freeHeap) {
+    MemScope memScope(MemSubsystem::Web);
+    if (millis() - lastDashboardPush < DASHBOARD_MIN_INTERVAL) {
+        return;
+    }
+
+    char temperatureText[12];
+    char humidityText[12];
+    char mq5Text[12];
+    char snapshot[DASHBOARD_BUFFER_SIZE];
+    snprintf(snapshot, sizeof(snapshot),
+             "{\"t\":%s,\"h\":%s,\"mq5\":%s,\"gas\":\"%s\",\"rssi\":%d,\"heap_kb\":%u,\"ver\":\"%s\"}",
+             jsonNumber(temperatureText, sizeof(temperatureText), temperature),
+             jsonNumber(humidityText, sizeof(humidityText), humidity),
+             jsonNumber(mq5Text, sizeof(mq5Text), mq5Percentage),
+             gasQuality, wifiSignalStrength, (unsigned)(freeHeap / 1024), version.c_str());
+
+    if (strcmp(snapshot, dashboardJson) == 0) {
+        return;  // Nothing changed
+    }
+
+    // One formatted message, queued to all connected clients
+    xSemaphoreTake(dashboardMutex, portMAX_DELAY);
+    strlcpy(dashboardJson, snapshot, sizeof(dashboardJson));
+    dashboardEventId++;
+    if (dashboardEvents.count() > 0) {
+        dashboardEvents.send(dashboardJson, "sensors", dashboardEventId);
+    }
+    xSemaphoreGive(dashboardMutex);
+    lastDashboardPush = millis();
+}
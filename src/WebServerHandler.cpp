@@ -1,65 +1,308 @@
-#include <WebServer.h>
+#include <ESPAsyncWebServer.h>
 #include <Update.h>
-#include <Adafruit_GFX.h>
-#include <Adafruit_ST7789.h>
+#include <mbedtls/sha256.h>
+#include "DeltaUpdate.h"
+#include "WebServerHandler.h"
+#include "WebAssets.h"
+#include "WebDashboard.h"
+#include "Telemetry.h"
+#include "Screenshot.h"
+#include "SensorHistory.h"
+#include "MemStats.h"
 
 // Wi-Fi and WebServer settings
-extern WebServer server;  // External reference to the web server
-extern String version;    // Firmware version string
+extern AsyncWebServer server;  // External reference to the web server
 
-extern Adafruit_ST7789 tft;  // External reference to the display object
+// Handlers run on the AsyncTCP task, so they only record what happened here.
+// The display and the restart are handled from the loop task.
+enum class WebUpdateState : uint8_t {
+    Idle,
+    Receiving,
+    Success,
+    Failed
+};
 
-void setupWebServer(const char* webAuthUser, const char* webAuthPass) {
-    server.on("/", HTTP_GET, []() {
-        String html = "<h1>ESP32 Firmware</h1>";
-        html += "<p>Current Firmware Version: " + version + "</p>";
-        html += "<form method='POST' action='/update' enctype='multipart/form-data'>";
-        html += "<input type='file' name='firmware'>";
-        html += "<input type='submit' value='Update Firmware'>";
-        html += "</form>";
-        server.send(200, "text/html", html);
-    });
+const unsigned long WEB_RESTART_DELAY = 1000;        // Let the response reach the browser first
+const unsigned long WEB_UPDATE_FAILED_DISPLAY = 3000; // How long a failed update stays on screen
 
-    server.on("/update", HTTP_POST, []() {
-        String message = Update.hasError() ? "Update Failed!" : "Update Success! Rebooting...";
-        server.sendHeader("Location", "/");
-        server.send(302, "text/plain", message);
-        ESP.restart();
-    }, [webAuthUser, webAuthPass]() {
-        if (!server.authenticate(webAuthUser, webAuthPass)) {
-            return server.requestAuthentication();
+volatile WebUpdateState updateState = WebUpdateState::Idle;
+volatile size_t updateReceived = 0;
+volatile size_t updateTotal = 0;  // Request size, 0 if unknown
+AsyncWebServerRequest *volatile uploadOwner = nullptr;  // Only one upload at a time
+volatile bool restartPending = false;
+volatile unsigned long restartRequestedAt = 0;
+
+// Upload pipeline, AsyncTCP task only. The image is hashed while it streams to flash
+// and only committed if the digest matches the one sent with the upload.
+mbedtls_sha256_context uploadHash;
+char expectedDigest[WEB_UPDATE_DIGEST_LENGTH + 1];  // Lowercase hex, empty if none was given
+char uploadDigest[WEB_UPDATE_DIGEST_LENGTH + 1];
+char uploadError[48];  // Set before updateState turns Failed, so the loop task can show it
+int uploadErrorStatus = 500;  // HTTP status for the failed upload
+
+// Throughput of the last upload, to tune the upload buffer size
+struct UploadStats {
+    uint32_t startedAt;   // micros()
+    uint32_t duration;    // Microseconds from the first to the last chunk
+    uint32_t chunks;
+    uint32_t writeTime;   // Microseconds spent in Update.write
+    uint32_t maxWrite;
+    size_t maxChunk;
+};
+UploadStats uploadStats;
+
+// Uploads to /update/delta are patches, rebuilt against the running image as they arrive
+bool uploadIsDelta = false;
+DeltaUpdate deltaUpdate;
+
+// Loop task only
+WebUpdateState drawnState = WebUpdateState::Idle;
+unsigned long failedShownAt = 0;
+
+// Digest from the X-Firmware-SHA256 header, or a "sha256" query or form field sent before the file.
+// Returns false if one was given but is not 64 hex digits.
+static bool readExpectedDigest(AsyncWebServerRequest *request) {
+    expectedDigest[0] = '\0';
+    const String *value = nullptr;
+    if (request->hasHeader(WEB_UPDATE_DIGEST_HEADER)) {
+        value = &request->getHeader(WEB_UPDATE_DIGEST_HEADER)->value();
+    } else if (request->hasParam("sha256")) {
+        value = &request->getParam("sha256")->value();
+    } else if (request->hasParam("sha256", true)) {
+        value = &request->getParam("sha256", true)->value();
+    }
+    if (value == nullptr || value->length() == 0) {
+        return true;
+    }
+
+    if (value->length() != WEB_UPDATE_DIGEST_LENGTH) {
+        return false;
+    }
+    for (size_t i = 0; i < WEB_UPDATE_DIGEST_LENGTH; i++) {
+        char c = tolower((*value)[i]);
+        if (!isxdigit(c)) {
+            return false;
         }
+        expectedDigest[i] = c;
+    }
+    expectedDigest[WEB_UPDATE_DIGEST_LENGTH] = '\0';
+    return true;
+}
 
-        HTTPUpload& upload = server.upload();
-        if (upload.status == UPLOAD_FILE_START) {
-            Serial.printf("Update: %s\n", upload.filename.c_str());
-            if (!Update.begin(UPDATE_SIZE_UNKNOWN)) {
-                Update.printError(Serial);
-            } else {
-                tft.fillScreen(ST77XX_BLACK);
-                tft.setCursor(10, 10);
-                tft.println("Updating...");
-            }
-        } else if (upload.status == UPLOAD_FILE_WRITE) {
-            if (Update.write(upload.buf, upload.currentSize) != upload.currentSize) {
-                Update.printError(Serial);
-            }
-        } else if (upload.status == UPLOAD_FILE_END) {
-            if (Update.end(true)) {
-                Serial.printf("Update Success: %u bytes\n", upload.totalSize);
-                tft.fillScreen(ST77XX_BLACK);
-                tft.setCursor(10, 10);
-                tft.print("Update Successful!");
-                delay(1000);
-            } else {
-                Update.printError(Serial);
+// Error from whichever writer the current upload uses
+static const char *writerError() {
+    return uploadIsDelta ? deltaUpdate.errorString() : Update.errorString();
+}
+
+static void failUpload(int status, const char *reason) {
+    if (uploadIsDelta) {
+        deltaUpdate.abort();
+    } else {
+        Update.abort();
+    }
+    mbedtls_sha256_free(&uploadHash);
+    uploadErrorStatus = status;
+    strlcpy(uploadError, reason, sizeof(uploadError));
+    Serial.printf("Update failed: %s\n", reason);
+    updateState = WebUpdateState::Failed;
+}
+
+// "<bytes> bytes in <ms> ms (<KB/s>), <chunks> chunks, write avg/max <us>"
+static void formatUploadReport(char *buffer, size_t size) {
+    uint32_t milliseconds = max<uint32_t>(uploadStats.duration / 1000, 1);
+    uint32_t chunks = max<uint32_t>(uploadStats.chunks, 1);
+    snprintf(buffer, size, "%u bytes in %u ms (%u KB/s), %u chunks up to %u B, write avg %u us max %u us",
+             (unsigned)updateReceived, (unsigned)milliseconds,
+             (unsigned)((uint64_t)updateReceived * 1000 / milliseconds / 1024),
+             (unsigned)uploadStats.chunks, (unsigned)uploadStats.maxChunk,
+             (unsigned)(uploadStats.writeTime / chunks), (unsigned)uploadStats.maxWrite);
+}
+
+// Upload body, called per chunk on the AsyncTCP task
+void handleUpdateUpload(AsyncWebServerRequest *request, const char *webAuthUser, const char *webAuthPass, bool delta,
+                        const String &filename, size_t index, uint8_t *data, size_t len, bool final) {
+    if (index == 0) {
+        if (!request->authenticate(webAuthUser, webAuthPass) || uploadOwner != nullptr) {
+            return;  // Answered by the request handler
+        }
+        uploadOwner = request;
+        request->onDisconnect([request]() {
+            if (uploadOwner == request) {
+                if (updateState == WebUpdateState::Receiving) {
+                    failUpload(500, "Connection lost");
+                }
+                uploadOwner = nullptr;
             }
+        });
+
+        Serial.printf("Update: %s%s\n", filename.c_str(), delta ? " (delta)" : "");
+        uploadIsDelta = delta;
+        updateReceived = 0;
+        updateTotal = request->contentLength();
+        uploadDigest[0] = '\0';
+        uploadError[0] = '\0';
+        memset(&uploadStats, 0, sizeof(uploadStats));
+        uploadStats.startedAt = micros();
+        mbedtls_sha256_init(&uploadHash);
+        mbedtls_sha256_starts(&uploadHash, 0);  // 0: SHA-256, not SHA-224
+
+        if (!readExpectedDigest(request)) {
+            failUpload(400, "Bad SHA-256 digest");
+        } else if (WEB_UPDATE_REQUIRE_SHA256 && expectedDigest[0] == '\0') {
+            failUpload(400, "SHA-256 digest required");
+        } else if (delta ? !deltaUpdate.begin() : !Update.begin(UPDATE_SIZE_UNKNOWN)) {
+            failUpload(500, writerError());
+        } else {
+            updateState = WebUpdateState::Receiving;
+        }
+    }
+
+    if (request != uploadOwner || updateState != WebUpdateState::Receiving) {
+        return;
+    }
+
+    mbedtls_sha256_update(&uploadHash, data, len);
+    uint32_t writeStart = micros();
+    bool written = delta ? deltaUpdate.write(data, len) : Update.write(data, len) == len;
+    uint32_t writeTime = micros() - writeStart;
+    if (!written) {
+        failUpload(delta ? 422 : 500, writerError());
+        return;
+    }
+    updateReceived += len;
+    uploadStats.chunks++;
+    uploadStats.writeTime += writeTime;
+    uploadStats.maxWrite = max(uploadStats.maxWrite, writeTime);
+    uploadStats.maxChunk = max(uploadStats.maxChunk, len);
+    uploadStats.duration = micros() - uploadStats.startedAt;
+
+    if (final) {
+        uint8_t digest[32];
+        mbedtls_sha256_finish(&uploadHash, digest);
+        mbedtls_sha256_free(&uploadHash);
+        for (size_t i = 0; i < sizeof(digest); i++) {
+            snprintf(uploadDigest + 2 * i, 3, "%02x", digest[i]);
+        }
+
+        char report[160];
+        formatUploadReport(report, sizeof(report));
+        Serial.printf("Update received: %s\nSHA-256 %s\n", report, uploadDigest);
+
+        // Check before Update.end, which would make the image bootable
+        if (expectedDigest[0] != '\0' && strcmp(expectedDigest, uploadDigest) != 0) {
+            failUpload(422, "SHA-256 mismatch");
+        } else if (delta ? deltaUpdate.end() : Update.end(true)) {
+            Serial.println("Update Success");
+            updateState = WebUpdateState::Success;
+        } else {
+            failUpload(delta ? 422 : 500, writerError());
         }
+    }
+}
+
+// Answer the upload once the last chunk is in, called on the AsyncTCP task
+void handleUpdateRequest(AsyncWebServerRequest *request, const char *webAuthUser, const char *webAuthPass) {
+    if (!request->authenticate(webAuthUser, webAuthPass)) {
+        return request->requestAuthentication();
+    }
+    if (uploadOwner == nullptr) {
+        request->send(400, "text/plain", "No firmware received");
+        return;
+    }
+    if (request != uploadOwner) {
+        request->send(409, "text/plain", "Another update is in progress");
+        return;
+    }
+
+    // Plain-text result with the digest and throughput, for scripted rollouts as much as browsers
+    char report[160];
+    formatUploadReport(report, sizeof(report));
+    char body[320];
+    if (updateState == WebUpdateState::Success) {
+        snprintf(body, sizeof(body), "Update Success! Rebooting...\nSHA-256 %s\n%s\n", uploadDigest, report);
+        request->send(200, "text/plain", body);
+        restartRequestedAt = millis();
+        restartPending = true;
+    } else {
+        snprintf(body, sizeof(body), "Update Failed: %s\nSHA-256 %s\n%s\n",
+                 uploadError, uploadDigest[0] != '\0' ? uploadDigest : "-", report);
+        request->send(uploadErrorStatus, "text/plain", body);
+    }
+    uploadOwner = nullptr;
+}
+
+void setupWebServer(const char* webAuthUser, const char* webAuthPass) {
+    setupWebAssets(server);     // "/" and the files from web/
+    setupWebDashboard(server);  // "/events"
+    setupTelemetry(server);     // "/metrics" and "/api/state"
+    setupScreenshot(server);    // "/screenshot.bmp"
+    setupSensorHistory(server); // "/api/history"
+
+    // Patch made by tools/make_delta.py against the running firmware. Registered first,
+    // "/update" would also match "/update/delta".
+    server.on("/update/delta", HTTP_POST, [webAuthUser, webAuthPass](AsyncWebServerRequest *request) {
+        handleUpdateRequest(request, webAuthUser, webAuthPass);
+    }, [webAuthUser, webAuthPass](AsyncWebServerRequest *request, const String &filename, size_t index,
+                                  uint8_t *data, size_t len, bool final) {
+        handleUpdateUpload(request, webAuthUser, webAuthPass, true, filename, index, data, len, final);
+    });
+
+    // Full firmware image
+    server.on("/update", HTTP_POST, [webAuthUser, webAuthPass](AsyncWebServerRequest *request) {
+        handleUpdateRequest(request, webAuthUser, webAuthPass);
+    }, [webAuthUser, webAuthPass](AsyncWebServerRequest *request, const String &filename, size_t index,
+                                  uint8_t *data, size_t len, bool final) {
+        handleUpdateUpload(request, webAuthUser, webAuthPass, false, filename, index, data, len, final);
     });
 
     server.begin();
+
+    // Everything the async server allocates happens on its TCP task, started by begin()
+    assignMemTask(xTaskGetHandle("async_tcp"), MemSubsystem::Web);
 }
 
 void handleWebServer() {
-    server.handleClient();
+    // Restart from the loop task once the response had time to go out
+    if (restartPending && millis() - restartRequestedAt >= WEB_RESTART_DELAY) {
+        ESP.restart();
+    }
+}
+
+bool isWebUpdateInProgress() {
+    return updateState != WebUpdateState::Idle;
+}
+
+bool updateWebUpdateScreen(OTAProgressView &progressView, bool forceRender) {
+    WebUpdateState state = updateState;
+    if (state == WebUpdateState::Idle) {
+        drawnState = WebUpdateState::Idle;
+        return false;
+    }
+
+    // A failed update stays on screen for a moment, then the pages take over again
+    if (state == WebUpdateState::Failed) {
+        if (drawnState != WebUpdateState::Failed) {
+            failedShownAt = millis();
+        } else if (millis() - failedShownAt >= WEB_UPDATE_FAILED_DISPLAY && uploadOwner == nullptr) {
+            updateState = WebUpdateState::Idle;
+            drawnState = WebUpdateState::Idle;
+            return false;
+        }
+    }
+
+    if (forceRender || drawnState == WebUpdateState::Idle) {
+        progressView.begin("Updating...");
+    }
+    if (forceRender || state != drawnState) {
+        if (state == WebUpdateState::Success) {
+            progressView.showResult(true, "Rebooting...");
+        } else if (state == WebUpdateState::Failed) {
+            progressView.showResult(false, uploadError);
+        }
+        drawnState = state;
+    }
+
+    // Content-Length includes the multipart framing, close enough for the bar
+    progressView.update(updateReceived, updateTotal);
+    return true;
 }
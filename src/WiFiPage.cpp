@@ -1,7 +1,41 @@
 #include "WiFiPage.h"
+#include "MemStats.h"
+#include <esp_wifi.h>
+
+void readNetworkInfo(NetworkInfo &info) {
+    // Same source as WiFi.SSID() and WiFi.RSSI(), without the String
+    wifi_ap_record_t ap;
+    if (esp_wifi_sta_get_ap_info(&ap) == ESP_OK) {
+        strlcpy(info.ssid, (const char *)ap.ssid, sizeof(info.ssid));
+        info.rssi = ap.rssi;
+    } else {
+        info.ssid[0] = '\0';
+        info.rssi = 0;
+    }
+
+    IPAddress ip = WiFi.localIP();
+    snprintf(info.ip, sizeof(info.ip), "%u.%u.%u.%u", ip[0], ip[1], ip[2], ip[3]);
+
+    uint8_t mac[6];
+    WiFi.macAddress(mac);
+    snprintf(info.mac, sizeof(info.mac), "%02X:%02X:%02X:%02X:%02X:%02X",
+             mac[0], mac[1], mac[2], mac[3], mac[4], mac[5]);
+}
+
+// Counter short enough for the line, e.g. "950", "12k", "3M"
+static void formatCount(uint32_t count, char *buffer, size_t size) {
+    if (count < 10000) {
+        snprintf(buffer, size, "%u", (unsigned)count);
+    } else if (count < 10000000) {
+        snprintf(buffer, size, "%uk", (unsigned)(count / 1000));
+    } else {
+        snprintf(buffer, size, "%uM", (unsigned)(count / 1000000));
+    }
+}
 
 WiFiPage::WiFiPage(Adafruit_ST7789 &display) 
-    : tft(display), lastSsid(""), lastIp(""), lastMac(""), lastRssi(0), lastCpuFreq(0), lastFreeMem("") {}
+    : tft(display), last(), lastCpuFreq(0), lastFreeMem(""), lastLargestBlock(""), lastMinFreeMem(""),
+      lastAllocations("") {}
 
 void WiFiPage::setup() {
     // Clear the screen and set initial text size/color
@@ -17,12 +51,13 @@ void WiFiPage::update(bool forceRender) {
 
 void WiFiPage::displayInfo(bool forceRender) {
     // Retrieve current data
-    String currentSsid = WiFi.SSID();          // Get SSID
-    String currentIp = WiFi.localIP().toString();
-    String currentMac = WiFi.macAddress();
-    int currentRssi = WiFi.RSSI();
+    NetworkInfo current;
+    readNetworkInfo(current);
     int currentCpuFreq = ESP.getCpuFreqMHz();
-    String currentFreeMem = formatMemory(ESP.getFreeHeap());
+    MemSnapshot memory;
+    readMemSnapshot(memory);
+    char currentFreeMem[sizeof(lastFreeMem)];
+    formatMemory(memory.freeHeap, currentFreeMem, sizeof(currentFreeMem));
 
     // Wi-Fi Info Header
     tft.setTextSize(2);  // Set text size for the header
@@ -31,37 +66,37 @@ void WiFiPage::displayInfo(bool forceRender) {
     tft.setTextSize(1);  // Set text size back to 1 for details
 
     // Update SSID
-    if (forceRender || currentSsid != lastSsid) {
+    if (forceRender || strcmp(current.ssid, last.ssid) != 0) {
         tft.fillRect(10, 30, 220, 10, ST77XX_BLACK); // Clear space for SSID
         tft.setCursor(10, 30);
-        tft.print("SSID: "); tft.println(currentSsid);
-        lastSsid = currentSsid;
+        tft.print("SSID: "); tft.println(current.ssid);
+        strlcpy(last.ssid, current.ssid, sizeof(last.ssid));
     }
 
     // Update IP Address
-    if (forceRender || currentIp != lastIp) {
+    if (forceRender || strcmp(current.ip, last.ip) != 0) {
         tft.fillRect(10, 50, 220, 10, ST77XX_BLACK); // Clear space for IP
         tft.setCursor(10, 50);
-        tft.print("IP: "); tft.println(currentIp);
-        lastIp = currentIp;
+        tft.print("IP: "); tft.println(current.ip);
+        strlcpy(last.ip, current.ip, sizeof(last.ip));
     }
 
     // Update MAC Address
-    if (forceRender || currentMac != lastMac) {
+    if (forceRender || strcmp(current.mac, last.mac) != 0) {
         tft.fillRect(10, 70, 220, 10, ST77XX_BLACK); // Clear space for MAC
         tft.setCursor(10, 70);
-        tft.print("MAC: "); tft.println(currentMac);
-        lastMac = currentMac;
+        tft.print("MAC: "); tft.println(current.mac);
+        strlcpy(last.mac, current.mac, sizeof(last.mac));
     }
 
     // Update Signal Strength
-    if (forceRender || currentRssi != lastRssi) {
+    if (forceRender || current.rssi != last.rssi) {
         tft.fillRect(10, 90, 220, 10, ST77XX_BLACK); // Clear space for Signal Strength
         tft.setCursor(10, 90);
         tft.print("Signal: "); 
-        tft.print(currentRssi); tft.print(" dBm (");
-        tft.print(rssiToPercent(currentRssi)); tft.println("%)");
-        lastRssi = currentRssi;
+        tft.print(current.rssi); tft.print(" dBm (");
+        tft.print(rssiToPercent(current.rssi)); tft.println("%)");
+        last.rssi = current.rssi;
     }
 
     // Display ESP32 Info header
@@ -79,12 +114,44 @@ void WiFiPage::displayInfo(bool forceRender) {
     }
 
     // Update Free Memory
-    if (forceRender || currentFreeMem != lastFreeMem) {
+    if (forceRender || strcmp(currentFreeMem, lastFreeMem) != 0) {
         tft.fillRect(10, 180, 220, 10, ST77XX_BLACK); // Clear space for Free Memory
         tft.setCursor(10, 180);
-        tft.print("Free Mem: "); tft.print(currentFreeMem); tft.println(" bytes");
-        lastFreeMem = currentFreeMem;
+        tft.print("Free Mem: "); tft.println(currentFreeMem);
+        strlcpy(lastFreeMem, currentFreeMem, sizeof(lastFreeMem));
     }
+
+    // Heap health: fragmentation, low-water mark and who allocates
+    char largestBlock[sizeof(lastLargestBlock)];
+    formatMemory(memory.largestBlock, largestBlock, sizeof(largestBlock));
+    snprintf(largestBlock + strlen(largestBlock), sizeof(largestBlock) - strlen(largestBlock), " (%u%% frag)",
+             (unsigned)memory.fragmentation);
+    drawLine(195, "Largest: ", largestBlock, lastLargestBlock, sizeof(lastLargestBlock), forceRender);
+
+    char minFreeMem[sizeof(lastMinFreeMem)];
+    formatMemory(memory.minFreeHeap, minFreeMem, sizeof(minFreeMem));
+    drawLine(210, "Min Free: ", minFreeMem, lastMinFreeMem, sizeof(lastMinFreeMem), forceRender);
+
+    char allocations[sizeof(lastAllocations)];
+    char weatherCount[8], mqttCount[8], webCount[8], displayCount[8];
+    formatCount(memory.allocations[static_cast<uint8_t>(MemSubsystem::Weather)], weatherCount, sizeof(weatherCount));
+    formatCount(memory.allocations[static_cast<uint8_t>(MemSubsystem::MQTT)], mqttCount, sizeof(mqttCount));
+    formatCount(memory.allocations[static_cast<uint8_t>(MemSubsystem::Web)], webCount, sizeof(webCount));
+    formatCount(memory.allocations[static_cast<uint8_t>(MemSubsystem::Display)], displayCount, sizeof(displayCount));
+    snprintf(allocations, sizeof(allocations), "W%s M%s Web%s D%s", weatherCount, mqttCount, webCount, displayCount);
+    drawLine(225, "Allocs: ", allocations, lastAllocations, sizeof(lastAllocations), forceRender);
+}
+
+// Redraw one "label value" line if the value changed
+void WiFiPage::drawLine(int16_t y, const char *label, const char *value, char *last, size_t lastSize,
+                        bool forceRender) {
+    if (!forceRender && strcmp(value, last) == 0) {
+        return;
+    }
+    tft.fillRect(10, y, 220, 10, ST77XX_BLACK);
+    tft.setCursor(10, y);
+    tft.print(label); tft.println(value);
+    strlcpy(last, value, lastSize);
 }
 
 // Convert RSSI to percentage
@@ -93,14 +160,3 @@ int WiFiPage::rssiToPercent(int rssi) {
     else if (rssi >= -50) return 100;
     else return 2 * (rssi + 100);
 }
-
-// Format memory in a human-readable format
-String WiFiPage::formatMemory(size_t bytes) {
-    if (bytes >= 1024 * 1024) {
-        return String(bytes / (1024 * 1024)) + " MB";
-    } else if (bytes >= 1024) {
-        return String(bytes / 1024) + " KB";
-    } else {
-        return String(bytes) + " bytes";
-    }
-}
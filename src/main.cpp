@@ -1,16 +1,28 @@
 #include <WiFi.h>
-#include <WebServer.h>
+#include <ESPAsyncWebServer.h>
 #include <Adafruit_GFX.h>
 #include <Adafruit_ST7789.h>
+#include "ShadowedST7789.h"
 #include "OTAUpdate.h"
 #include "WebServerHandler.h"
+#include "WebDashboard.h"
+#include "Telemetry.h"
+#include "MemStats.h"
+#include "SensorHistory.h"
 #include "slideshow.h"
 #include "DHTPage.h"
 #include "WiFiPage.h"
 #include "WeatherPage.h"
+#include "ForecastPage.h"
+#include "WeatherHttpSession.h"
+#include "WeatherRefreshPolicy.h"
+#include "WeatherShare.h"
+#include "WeatherBenchmark.h"
 #include "MQTTHandler.h"
 #include "secrets.h"
 #include "HCSR04Sensor.h"
+#include "DeviceIdentity.h"
+#include "GasAlarm.h"
 
 // Pin definitions for ST7789 display
 #define TFT_CS     5    
@@ -23,24 +35,27 @@
 
 // Instantiate the HC-SR04 sensor
 HCSR04Sensor ultrasonicSensor(14, 27);
-Adafruit_ST7789 tft = Adafruit_ST7789(TFT_CS, TFT_DC, TFT_RST);
+ShadowedST7789 tft(TFT_CS, TFT_DC, TFT_RST);  // Keeps a copy of the screen for /screenshot.bmp
 String version = "v0.9.0";
+const char* ntpServer = "pool.ntp.org";
+const char* weatherCity = "Munich";
 
 // Enumeration for pages
 enum class Page {
     SLIDESHOW,
     DHT,
     WEATHER,
+    FORECAST,
     WIFI
 };
 
 // Global variables
 bool forceRender = true;
-Page pages[] = {Page::SLIDESHOW, Page::DHT, Page::WEATHER, Page::WIFI};
+Page pages[] = {Page::SLIDESHOW, Page::DHT, Page::WEATHER, Page::FORECAST, Page::WIFI};
 int pageIndex = 1;
 
 // Web Server setup
-WebServer server(80);
+AsyncWebServer server(80);  // Serves from the AsyncTCP task on core 0
 
 // Button timing constants
 const unsigned long DOUBLE_CLICK_DELAY = 300;  
@@ -62,11 +77,22 @@ unsigned long lastClickTime = 0;
 unsigned long lastSwitchTime = 0;
 bool isDimmed = false;
 bool slideshowUserInitiated = false;
+bool gasOverlayShown = false;
+bool webUpdateShown = false;
+
+// MQ-5 sampling and alarm
+GasAlarm gasAlarm(MQ5_PIN);
+
+// Shared keep-alive connection for the weather and forecast requests
+WeatherHttpSession weatherHttp(WEATHER_API_HOST, WEATHER_API_PORT);
 
 // Page objects
-DHTPage dhtPage(tft);
+OTAProgressView updateProgress(tft);  // ArduinoOTA and web uploads
+DHTPage dhtPage(tft, gasAlarm);
 WiFiPage wifiPage(tft);
-WeatherPage weatherPage(tft, openWeatherApiKey, "Munich");
+WeatherPage weatherPage(tft, weatherHttp, openWeatherApiKey, weatherCity);
+ForecastPage forecastPage(tft, weatherHttp, weatherPage, openWeatherApiKey, weatherCity);
+WeatherRefreshPolicy weatherRefresh(weatherPage, forecastPage, weatherHttp);
 
 // Function declarations
 void setupDisplay();
@@ -82,15 +108,28 @@ void readUltrasonicSensor();
 void checkPageSwitching();
 void checkInactivity();
 void checkButtonLongPress();
+bool showGasAlarm();
+bool showWebUpdate();
+ScreenState currentScreenState();
+unsigned long timeUntilShown(Page page);
 
 void setup() {
     Serial.begin(115200);
+    beginMemStats();  // Count the loop task's allocations from here on
+    setupDeviceIdentity();
     setupDisplay();
     connectToWiFi();
     initializeComponents();
+
+    if (WEATHER_BENCHMARK) {
+        runWeatherBenchmark(tft, weatherHttp);
+    }
 }
 
 void loop() {
+    unsigned long loopStart = micros();
+    uint32_t allocationsBefore = loopAllocationCount();
+    showGasAlarm();    // As early as possible in every pass
     handleOTA();       
     handleWebServer(); 
     handleButtonPress();
@@ -100,11 +139,14 @@ void loop() {
     readUltrasonicSensor();
     checkPageSwitching();
     checkInactivity();
+    weatherRefresh.loop(currentScreenState(), timeUntilShown(Page::WEATHER), timeUntilShown(Page::FORECAST));
+    recordLoopPass(micros() - loopStart, loopAllocationCount() - allocationsBefore);
 }
 
 // Setup display settings
 void setupDisplay() {
     tft.init(240, 240);
+    tft.beginShadow();
     tft.fillScreen(ST77XX_BLACK);
     tft.setTextSize(2);
     tft.setTextColor(ST77XX_WHITE);
@@ -116,7 +158,7 @@ void setupDisplay() {
 
 // Connect to WiFi network
 void connectToWiFi() {
-    WiFi.hostname("weatherstation-kitchen");
+    WiFi.hostname(getHostname());
     WiFi.begin(ssid, wifiPass);
     while (WiFi.status() != WL_CONNECTED) {
         delay(500);
@@ -124,23 +166,72 @@ void connectToWiFi() {
         tft.setCursor(10, 40);
         tft.println("Connecting to WiFi...");
     }
+
+    // Wall clock for timestamping samples queued during broker outages
+    configTime(0, 0, ntpServer);
 }
 
 // Initialize components
 void initializeComponents() {
-    setupOTA(otaPassword);
+    setupOTA(otaPassword, updateProgress);
     setupWebServer(webAuthUser, webAuthPass);
+    if (WEATHER_SHARE) {
+        setupWeatherShare(weatherCity);  // Before MQTT, which subscribes to the share topic
+    }
     setupMQTT(mqttUser, mqttPassword); 
+    gasAlarm.begin();  // Needs MQTT for publishing alarms
     ultrasonicSensor.begin(); // Initialize the ultrasonic sensor
     initSlideshow(tft);
     dhtPage.setup();
     wifiPage.setup();
     weatherPage.setup();
+    forecastPage.setup();  // After weatherPage, which provides the timezone offset
     pinMode(BUTTON_PIN, INPUT_PULLUP); 
 }
 
+// Draw the gas alarm overlay over whatever page is active. Returns true while it owns the screen.
+bool showGasAlarm() {
+    if (gasAlarm.updateOverlay(tft, forceRender)) {
+        if (isDimmed || millis() - lastActionTime >= DIM_DELAY) {
+            setBacklight(100);
+            isDimmed = false;
+        }
+        lastActionTime = millis();  // Keep the screen on while the alarm lasts
+        forceRender = false;
+        gasOverlayShown = true;
+        return true;
+    }
+
+    if (gasOverlayShown) {
+        gasOverlayShown = false;
+        forceRender = true;  // Alarm cleared, redraw the page underneath
+    }
+    return false;
+}
+
+// Firmware upload status from the web server. Returns true while it owns the screen.
+bool showWebUpdate() {
+    if (updateWebUpdateScreen(updateProgress, forceRender || !webUpdateShown)) {
+        lastActionTime = millis();
+        forceRender = false;
+        webUpdateShown = true;
+        return true;
+    }
+
+    if (webUpdateShown) {
+        webUpdateShown = false;
+        forceRender = true;  // Update over, redraw the page underneath
+    }
+    return false;
+}
+
 // Update the display based on the current page
 void updateDisplay() {
+    MemScope memScope(MemSubsystem::Display);
+    if (gasOverlayShown || showWebUpdate()) {
+        return;  // The gas overlay is drawn by showGasAlarm() at the start of the pass
+    }
+
     switch (pages[pageIndex]) {
         case Page::SLIDESHOW:
             updateSlideshow(tft, forceRender); 
@@ -149,7 +240,10 @@ void updateDisplay() {
             dhtPage.update(forceRender); 
             break;
         case Page::WEATHER:
-            weatherPage.update(false); 
+            weatherPage.update(forceRender); 
+            break;
+        case Page::FORECAST:
+            forecastPage.update(forceRender);
             break;
         case Page::WIFI:
             wifiPage.update(forceRender); 
@@ -166,7 +260,9 @@ void changePage(int direction) {
     else if (pageIndex < 0) 
         pageIndex = sizeof(pages) / sizeof(pages[0]) - 1; 
 
-    tft.fillScreen(ST77XX_BLACK);  
+    if (!gasOverlayShown) {
+        tft.fillScreen(ST77XX_BLACK);  // Keep the alarm on screen, the page is drawn once it clears
+    }
     forceRender = true;  
     updateDisplay();  
 }
@@ -211,6 +307,8 @@ void handleButtonRelease() {
             } else if (pages[pageIndex] == Page::DHT) {
                 pageIndex = static_cast<int>(Page::WEATHER);
             } else if (pages[pageIndex] == Page::WEATHER) {
+                pageIndex = static_cast<int>(Page::FORECAST);
+            } else if (pages[pageIndex] == Page::FORECAST) {
                 pageIndex = static_cast<int>(Page::DHT);
             } else {
                 pageIndex = static_cast<int>(Page::DHT);  // Default to DHT page
@@ -230,8 +328,11 @@ void handleButtonRelease() {
     }
 
     // Refresh weather data if on Weather page
-    if (pages[pageIndex] == Page::WEATHER) {
+    bool overlayActive = gasAlarm.isActive() || isWebUpdateInProgress();
+    if (pages[pageIndex] == Page::WEATHER && !overlayActive) {
         weatherPage.update(true);
+    } else if (pages[pageIndex] == Page::FORECAST && !overlayActive) {
+        forecastPage.update(true);
     }
 
     // Reset inactivity timer
@@ -260,16 +361,26 @@ void publishAllSensorData() {
     float dhtTemp = dhtPage.getTemperature();
     float dhtHumidity = dhtPage.getHumidity();
     float mq5Percentage = dhtPage.getMQ5Percentage();
-    String gasQuality = dhtPage.getGasQuality();
-    int wifiSignalStrength = WiFi.RSSI();  // Wi-Fi signal strength
-    String ipAddress = WiFi.localIP().toString();  // Get IP address
-    String macAddress = WiFi.macAddress();  // Get MAC address
+    GasQuality gasQuality = dhtPage.getGasQuality();
+    NetworkInfo network;  // SSID, IP, MAC and signal strength, formatted on the stack
+    readNetworkInfo(network);
+    int wifiSignalStrength = network.rssi;
     int cpuFreq = ESP.getCpuFreqMHz();  // Get CPU frequency
-    String freeMem = wifiPage.formatMemory(ESP.getFreeHeap());  // Get free memory
+    uint32_t freeHeap = ESP.getFreeHeap();  // Get free memory
 
     // Pass all sensor data to the MQTTHandler for processing and publishing
     processAndPublishSensorData(dhtTemp, dhtHumidity, mq5Percentage, gasQuality, wifiSignalStrength, 
-                                ipAddress, macAddress, cpuFreq, freeMem);
+                                network.ip, network.mac, cpuFreq, freeHeap);
+
+    // Browsers on the dashboard get the same readings over Server-Sent Events
+    updateDashboard(dhtTemp, dhtHumidity, mq5Percentage, gasQualityName(gasQuality), wifiSignalStrength, freeHeap);
+
+    // Snapshot for the /metrics and /api/state endpoints
+    updateTelemetry(dhtTemp, dhtHumidity, mq5Percentage, gasQualityName(gasQuality), gasAlarm.isActive(),
+                    wifiSignalStrength);
+
+    // One sample a minute for /api/history
+    recordSensorHistory(dhtTemp, dhtHumidity, mq5Percentage, wifiSignalStrength);
 }
 
 // Read ultrasonic sensor and handle actions based on distance
@@ -299,13 +410,21 @@ void readUltrasonicSensor() {
 
 // Check for automatic page switching
 void checkPageSwitching() {
-    if ((pages[pageIndex] == Page::DHT || pages[pageIndex] == Page::WEATHER) && 
+    if (gasAlarm.isActive() || isWebUpdateInProgress()) {
+        return;  // Rotation would draw over the alarm or update screen
+    }
+
+    if ((pages[pageIndex] == Page::DHT || pages[pageIndex] == Page::WEATHER || pages[pageIndex] == Page::FORECAST) && 
         (millis() - lastSwitchTime >= PAGE_SWITCH_INTERVAL)) {
-        // Switch to the other page
+        // Rotate DHT -> Weather -> Forecast -> DHT
         if (pages[pageIndex] == Page::DHT) {
             pageIndex = static_cast<int>(Page::WEATHER);
             tft.fillScreen(ST77XX_BLACK);  
             weatherPage.update(true); 
+        } else if (pages[pageIndex] == Page::WEATHER) {
+            pageIndex = static_cast<int>(Page::FORECAST);
+            tft.fillScreen(ST77XX_BLACK);  
+            forecastPage.update(true); 
         } else {
             pageIndex = static_cast<int>(Page::DHT);
             tft.fillScreen(ST77XX_BLACK);  
@@ -315,6 +434,40 @@ void checkPageSwitching() {
     }
 }
 
+// Time until the rotation in checkPageSwitching() brings up a page, 0 while it is shown
+unsigned long timeUntilShown(Page page) {
+    static const Page rotation[] = {Page::DHT, Page::WEATHER, Page::FORECAST};
+    const int rotationLength = sizeof(rotation) / sizeof(rotation[0]);
+
+    Page current = pages[pageIndex];
+    if (current == page) {
+        return 0;
+    }
+
+    int currentPosition = -1;
+    int targetPosition = -1;
+    for (int i = 0; i < rotationLength; i++) {
+        if (rotation[i] == current) currentPosition = i;
+        if (rotation[i] == page) targetPosition = i;
+    }
+    if (currentPosition < 0 || targetPosition < 0 || gasAlarm.isActive()) {
+        return WEATHER_NOT_SCHEDULED;  // Slideshow, WiFi page or alarm: no rotation running
+    }
+
+    unsigned long elapsed = millis() - lastSwitchTime;
+    unsigned long remaining = elapsed < PAGE_SWITCH_INTERVAL ? PAGE_SWITCH_INTERVAL - elapsed : 0;
+    int steps = (targetPosition - currentPosition + rotationLength) % rotationLength;
+    return remaining + (steps - 1) * PAGE_SWITCH_INTERVAL;
+}
+
+// Backlight state as set by checkInactivity()
+ScreenState currentScreenState() {
+    if (millis() - lastActionTime >= SCREEN_OFF_DELAY) {
+        return ScreenState::Off;
+    }
+    return isDimmed ? ScreenState::Dimmed : ScreenState::On;
+}
+
 // Check for inactivity to dim the backlight or activate slideshow
 void checkInactivity() {
     if ((millis() - lastActionTime >= DIM_DELAY) && !isDimmed) {
@@ -0,0 +1,104 @@
+#!/usr/bin/env python3
+"""Embed the files in web/ into flash as pre-gzipped arrays.
+
+Writes include/WebAssetsData.h with one PROGMEM array per file plus its URL,
+content type and ETag. Runs before every PlatformIO build (extra_scripts) and
+only rewrites the header when an asset changed, so unchanged trees do not
+recompile. Can also be run by hand:
+
+    python3 tools/embed_web_assets.py
+
+Compression is deterministic (no timestamp in the gzip header), so the same
+sources always give the same bytes and the same ETags.
+"""
+
+import gzip
+import hashlib
+from pathlib import Path
+
+CONTENT_TYPES = {
+    ".html": "text/html",
+    ".css": "text/css",
+    ".js": "application/javascript",
+    ".json": "application/json",
+    ".svg": "image/svg+xml",
+    ".ico": "image/x-icon",
+    ".png": "image/png",
+}
+INDEX = "index.html"  # Also served as "/"
+BYTES_PER_LINE = 16
+
+
+def project_dir():
+    try:
+        return Path(env.subst("$PROJECT_DIR"))  # noqa: F821 - provided by PlatformIO
+    except NameError:
+        return Path(__file__).resolve().parent.parent
+
+
+def symbol(relative):
+    return "webAsset_" + "".join(c if c.isalnum() else "_" for c in str(relative))
+
+
+def render(assets):
+    lines = [
+        "// Generated by tools/embed_web_assets.py from web/, do not edit",
+        "#ifndef WEB_ASSETS_DATA_H",
+        "#define WEB_ASSETS_DATA_H",
+        "",
+        '#include "WebAssets.h"',
+        "",
+    ]
+    for asset in assets:
+        lines.append("// %s: %d bytes, %d gzipped" % (asset["url"], asset["size"], len(asset["data"])))
+        lines.append("const uint8_t %s[] PROGMEM = {" % asset["symbol"])
+        data = asset["data"]
+        for offset in range(0, len(data), BYTES_PER_LINE):
+            chunk = data[offset:offset + BYTES_PER_LINE]
+            lines.append("    " + ", ".join("0x%02x" % b for b in chunk) + ",")
+        lines.append("};")
+        lines.append("")
+
+    lines.append("const WebAsset webAssets[] = {")
+    for asset in assets:
+        lines.append('    {"%s", "%s", %s, sizeof(%s), "\\"%s\\""},' % (
+            asset["url"], asset["type"], asset["symbol"], asset["symbol"], asset["etag"]))
+    lines.append("};")
+    lines.append("const size_t webAssetCount = sizeof(webAssets) / sizeof(webAssets[0]);")
+    lines.append("")
+    lines.append("#endif // WEB_ASSETS_DATA_H")
+    lines.append("")
+    return "\n".join(lines)
+
+
+def embed():
+    root = project_dir()
+    source = root / "web"
+    target = root / "include" / "WebAssetsData.h"
+
+    assets = []
+    for path in sorted(p for p in source.rglob("*") if p.is_file()):
+        relative = path.relative_to(source)
+        content_type = CONTENT_TYPES.get(path.suffix.lower())
+        if content_type is None:
+            print("embed_web_assets: skipping %s (unknown type)" % relative)
+            continue
+        raw = path.read_bytes()
+        data = gzip.compress(raw, compresslevel=9, mtime=0)
+        assets.append({
+            "url": "/" + relative.as_posix(),
+            "type": content_type,
+            "symbol": symbol(relative),
+            "size": len(raw),
+            "data": data,
+            "etag": hashlib.sha256(data).hexdigest()[:16],
+        })
+
+    header = render(assets)
+    if target.exists() and target.read_text() == header:
+        return
+    target.write_text(header)
+    print("embed_web_assets: wrote %s (%d assets)" % (target.relative_to(root), len(assets)))
+
+
+embed()
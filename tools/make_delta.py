@@ -0,0 +1,157 @@
+#!/usr/bin/env python3
+"""Build a delta update between two firmware images.
+
+The station applies the patch against the firmware it is running, so only
+what changed between the builds goes over Wi-Fi:
+
+    python3 tools/make_delta.py old/firmware.bin .pio/build/esp32dev/firmware.bin -o update.delta
+    curl -u admin:password -F firmware=@update.delta http://<station>/update/delta
+
+old/firmware.bin must be exactly the image the station runs; the patch
+carries its SHA-256 and the station refuses a patch made for another build.
+
+Patch format (little-endian):
+
+    "WSD1"                      magic
+    u32  source size, 32 bytes source SHA-256
+    u32  target size, 32 bytes target SHA-256
+    zlib stream of commands until the target is complete:
+        u32 source offset, u32 diff length, u32 extra length
+        diff length bytes   added (mod 256) to the source bytes at source offset
+        extra length bytes  copied to the target as they are
+
+Matching follows bsdiff: exact seeds are extended while most bytes still
+agree, so code that moved by a few bytes becomes mostly zero diff bytes and
+compresses away. Unlike bsdiff everything is one stream in target order, so
+the station can apply it while it downloads with a fixed amount of memory.
+"""
+
+import argparse
+import hashlib
+import struct
+import sys
+import zlib
+
+MAGIC = b"WSD1"
+HEADER = struct.Struct("<4sI32sI32s")
+COMMAND = struct.Struct("<III")
+SEED = 16           # Bytes that have to match exactly to start a region
+INDEX_STRIDE = 4    # Source offsets indexed for seeds
+GIVE_UP = 64        # Stop extending once the score fell this far below its best
+
+
+def build_index(source):
+    index = {}
+    for offset in range(0, len(source) - SEED + 1, INDEX_STRIDE):
+        index.setdefault(source[offset:offset + SEED], offset)
+    return index
+
+
+def extend_forward(source, target, s, t):
+    # Longest length where matches outweigh mismatches, as in bsdiff
+    best_length, best_score, score = 0, 0, 0
+    limit = min(len(source) - s, len(target) - t)
+    for i in range(limit):
+        score += 1 if source[s + i] == target[t + i] else -1
+        if score > best_score:
+            best_score, best_length = score, i + 1
+        elif score < best_score - GIVE_UP:
+            break
+    return best_length
+
+
+def extend_backward(source, target, s, t, limit):
+    best_length, best_score, score = 0, 0, 0
+    for i in range(1, min(limit, s) + 1):
+        score += 1 if source[s - i] == target[t - i] else -1
+        if score > best_score:
+            best_score, best_length = score, i
+        elif score < best_score - GIVE_UP:
+            break
+    return best_length
+
+
+def diff(source, target):
+    """Yield (source offset, diff bytes, extra bytes) covering the whole target."""
+    index = build_index(source)
+    extra_start = 0
+    t = 0
+    while t <= len(target) - SEED:
+        s = index.get(target[t:t + SEED])
+        if s is None:
+            t += 1
+            continue
+
+        forward = extend_forward(source, target, s, t)
+        backward = extend_backward(source, target, s, t, t - extra_start)
+        s0, t0, t1 = s - backward, t - backward, t + forward
+        diff_bytes = bytes((target[t0 + i] - source[s0 + i]) & 0xFF for i in range(t1 - t0))
+        yield s0, diff_bytes, target[extra_start:t0]
+        extra_start = t = t1
+
+    if extra_start < len(target):
+        yield 0, b"", target[extra_start:]
+
+
+def make_patch(source, target):
+    commands = bytearray()
+    for s0, diff_bytes, extra in diff(source, target):
+        # Extra bytes come after the diff in a command, so emit literals before the region as their own command
+        if extra:
+            commands += COMMAND.pack(0, 0, len(extra)) + extra
+        if diff_bytes:
+            commands += COMMAND.pack(s0, len(diff_bytes), 0) + diff_bytes
+    header = HEADER.pack(MAGIC, len(source), hashlib.sha256(source).digest(),
+                         len(target), hashlib.sha256(target).digest())
+    return header + zlib.compress(bytes(commands), 9)
+
+
+def apply_patch(source, patch):
+    """Reference applier, mirrors DeltaUpdate.cpp"""
+    magic, source_size, source_hash, target_size, target_hash = HEADER.unpack_from(patch)
+    if magic != MAGIC:
+        raise ValueError("not a delta patch")
+    if source_size != len(source) or hashlib.sha256(source).digest() != source_hash:
+        raise ValueError("patch was made for another source image")
+
+    commands = zlib.decompress(patch[HEADER.size:])
+    target = bytearray()
+    position = 0
+    while position < len(commands):
+        s, diff_length, extra_length = COMMAND.unpack_from(commands, position)
+        position += COMMAND.size
+        for i in range(diff_length):
+            target.append((source[s + i] + commands[position + i]) & 0xFF)
+        position += diff_length
+        target += commands[position:position + extra_length]
+        position += extra_length
+
+    if len(target) != target_size or hashlib.sha256(target).digest() != target_hash:
+        raise ValueError("reconstructed image does not match")
+    return bytes(target)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("source", help="firmware image the station is running")
+    parser.add_argument("target", help="new firmware image")
+    parser.add_argument("-o", "--output", required=True, help="patch file to write")
+    args = parser.parse_args()
+
+    with open(args.source, "rb") as f:
+        source = f.read()
+    with open(args.target, "rb") as f:
+        target = f.read()
+
+    patch = make_patch(source, target)
+    apply_patch(source, patch)  # Never ship a patch that does not round-trip
+    with open(args.output, "wb") as f:
+        f.write(patch)
+
+    print("%s: %d bytes for a %d byte image (%.1f%%), verified" % (
+        args.output, len(patch), len(target), 100.0 * len(patch) / max(len(target), 1)))
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
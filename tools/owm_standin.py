@@ -0,0 +1,157 @@
+#!/usr/bin/env python3
+"""Local stand-in for the OpenWeatherMap endpoints used by the station.
+
+Replays the recorded responses in owm_fixtures/ on /data/2.5/weather and
+/data/2.5/forecast. The city in ?q= selects the scenario, so the firmware
+(or curl) can ask for each case without restarting the server:
+
+    ok         recorded payload, with ETag / Last-Modified and 304 support
+    slow       recorded payload trickled out in small pieces
+    truncated  Content-Length of the full payload, connection closed halfway
+    oversized  recorded payload padded with large fields the filter must skip
+    malformed  broken JSON
+    chunked    recorded payload with Transfer-Encoding: chunked, which the station rejects
+
+Any other city is served as "ok". Usage:
+
+    python3 tools/owm_standin.py --port 8080
+
+and build the station with the esp32dev-bench environment (or set
+WEATHER_API_HOST / WEATHER_API_PORT in build_flags) to point it here.
+"""
+
+import argparse
+import hashlib
+import json
+import time
+from email.utils import formatdate
+from http.server import BaseHTTPRequestHandler, ThreadingHTTPServer
+from pathlib import Path
+from urllib.parse import parse_qs, urlparse
+
+FIXTURES = Path(__file__).parent / "owm_fixtures"
+FORECAST_ENTRIES = 40  # 5 days of 3-hour slots
+SLOW_CHUNK = 64        # Bytes per write in the slow scenario
+SLOW_DELAY = 0.2       # Seconds between writes
+OVERSIZED_PADDING = 48 * 1024
+LAST_MODIFIED = formatdate(time.time(), usegmt=True)
+
+
+def load_weather():
+    return json.loads((FIXTURES / "weather.json").read_text())
+
+
+def load_forecast():
+    entry = json.loads((FIXTURES / "forecast_entry.json").read_text())
+    entries = []
+    for i in range(FORECAST_ENTRIES):
+        slot = json.loads(json.dumps(entry))
+        slot["dt"] = entry["dt"] + i * 3 * 3600
+        slot["main"]["temp_min"] = round(entry["main"]["temp_min"] + (i % 8) - 3, 2)
+        slot["main"]["temp_max"] = round(entry["main"]["temp_max"] + (i % 8) - 2, 2)
+        entries.append(slot)
+    return {"cod": "200", "message": 0, "cnt": len(entries), "list": entries,
+            "city": {"id": 2867714, "name": "Munich", "country": "DE", "timezone": 7200}}
+
+
+def pad(document):
+    # Large fields the station's filter has to skip without storing
+    document["padding"] = ["x" * 64] * (OVERSIZED_PADDING // 68)
+    document["name"] = "M" + "u" * 2048 + "nich"
+    return document
+
+
+def render(resource, scenario):
+    document = load_weather() if resource == "weather" else load_forecast()
+    if scenario == "oversized":
+        document = pad(document)
+    body = json.dumps(document, separators=(",", ":")).encode()
+    if scenario == "malformed":
+        body = body[: len(body) // 3] + b'",:}{' + body[len(body) // 3:]
+    return body
+
+
+class StandInHandler(BaseHTTPRequestHandler):
+    protocol_version = "HTTP/1.1"  # Keep-alive, like the real API
+    disable_nagle_algorithm = True  # Headers and body go out in separate writes
+
+    def do_GET(self):
+        url = urlparse(self.path)
+        resource = url.path.rsplit("/", 1)[-1]
+        if resource not in ("weather", "forecast"):
+            self.send_error(404)
+            return
+
+        scenario = parse_qs(url.query).get("q", ["ok"])[0].lower()
+        body = render(resource, scenario)
+        etag = '"%s"' % hashlib.sha1(body).hexdigest()[:16]
+
+        if scenario == "ok" and self.headers.get("If-None-Match") == etag:
+            self.send_response(304)
+            self.send_header("ETag", etag)
+            self.send_header("Content-Length", "0")
+            self.end_headers()
+            return
+
+        self.send_response(200)
+        self.send_header("Content-Type", "application/json; charset=utf-8")
+        if scenario == "chunked":
+            self.send_header("Transfer-Encoding", "chunked")
+        else:
+            self.send_header("Content-Length", str(len(body)))
+        if scenario == "ok":
+            self.send_header("ETag", etag)
+            self.send_header("Last-Modified", LAST_MODIFIED)
+        self.end_headers()
+
+        if scenario == "slow":
+            for offset in range(0, len(body), SLOW_CHUNK):
+                self.wfile.write(body[offset:offset + SLOW_CHUNK])
+                self.wfile.flush()
+                time.sleep(SLOW_DELAY)
+        elif scenario == "chunked":
+            self.close_connection = True
+            try:
+                for offset in range(0, len(body), 1024):
+                    piece = body[offset:offset + 1024]
+                    self.wfile.write(b"%x\r\n%s\r\n" % (len(piece), piece))
+                self.wfile.write(b"0\r\n\r\n")
+            except ConnectionError:
+                pass  # The station hangs up as soon as it sees the header
+        elif scenario == "truncated":
+            self.wfile.write(body[: len(body) // 2])
+            self.wfile.flush()
+            self.close_connection = True
+        else:
+            self.wfile.write(body)
+
+    def end_headers(self):
+        # The station sends HTTP/1.0 requests, those only stay open if the response says so
+        if self.request_version == "HTTP/1.0" and not self.close_connection:
+            self.send_header("Connection", "keep-alive")
+        super().end_headers()
+
+    def log_message(self, fmt, *args):
+        print("%s %s" % (self.address_string(), fmt % args), flush=True)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("--host", default="0.0.0.0")
+    parser.add_argument("--port", type=int, default=8080)
+    parser.add_argument("--idle-timeout", type=float, default=None,
+                        help="close kept-alive connections after this many idle seconds, like the real API")
+    args = parser.parse_args()
+
+    StandInHandler.timeout = args.idle_timeout
+
+    server = ThreadingHTTPServer((args.host, args.port), StandInHandler)
+    print("OpenWeatherMap stand-in on http://%s:%d" % (args.host, args.port), flush=True)
+    try:
+        server.serve_forever()
+    except KeyboardInterrupt:
+        pass
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,17 @@
+// Live readings pushed by the station over Server-Sent Events
+const $ = id => document.getElementById(id);
+const show = (id, v, d) => { $(id).textContent = v === null ? '-' : (d === undefined ? v : v.toFixed(d)); };
+
+const es = new EventSource('/events');
+es.onopen = () => { $('state').textContent = 'Live'; };
+es.onerror = () => { $('state').textContent = 'Reconnecting...'; };
+es.addEventListener('sensors', e => {
+  const s = JSON.parse(e.data);
+  show('t', s.t, 1);
+  show('h', s.h, 1);
+  show('mq5', s.mq5, 1);
+  show('gas', s.gas);
+  show('rssi', s.rssi);
+  show('heap', s.heap_kb);
+  $('ver').textContent = s.ver;
+});